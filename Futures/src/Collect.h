@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Future.h"
+
+// Core of a future that joins a vector of input futures. One node per input is
+// registered as that input's continuation and all nodes and result slots are
+// allocated up front, so a join of any size costs a fixed number of allocations.
+// Inputs report through atomic counters so slots are written without a lock.
+template<class T, class Result>
+struct JoinCore : ValueCore<Result> {
+    struct Node : Continuation<T> {
+        Node(JoinCore* core, std::size_t index) : core_{core}, index_{index} {}
+
+        void run(T&& value) override {
+            core_->onValue(index_, std::move(value));
+            core_->nodeDone();
+        }
+
+        void fail(std::exception_ptr error) override {
+            core_->onError(std::move(error));
+            core_->nodeDone();
+        }
+
+        void discard() override {
+            core_->nodeDone();
+        }
+
+        JoinCore* core_;
+        std::size_t index_;
+    };
+
+    // Called once per input, on that input's executor
+    virtual void onValue(std::size_t index, T&& value) = 0;
+
+    // The first input to fail completes the output with its exception, unless the
+    // output already has its value
+    void onError(std::exception_ptr error) {
+        if(settle()) {
+            this->set_exception(std::move(error));
+        }
+    }
+
+    // True for the one caller that may complete the output
+    bool settle() {
+        return !settled_.exchange(true, std::memory_order_acq_rel);
+    }
+
+    // Register a node with each input. The output uses the first input's executor.
+    // With no inputs the caller completes the output, which has no executor until via.
+    template<class InputT>
+    ContinuableFuture<Result> attach(std::vector<ContinuableFuture<InputT>>&& futures) {
+        CorePtr<CoreBase<Result>> output{this};
+        if(futures.empty()) {
+            return ContinuableFuture<Result>{std::move(output)};
+        }
+        this->setExecutor(futures.front().core_->getExecutor());
+        outstanding_ = futures.size();
+        nodes_.reserve(futures.size());
+        for(std::size_t i = 0; i < futures.size(); ++i) {
+            nodes_.emplace_back(this, i);
+        }
+        // One reference on behalf of all inputs, dropped when the last one reports
+        this->acquire();
+        for(std::size_t i = 0; i < futures.size(); ++i) {
+            futures[i].core_->setCallback(&nodes_[i]);
+            futures[i].core_ = {};
+        }
+        return ContinuableFuture<Result>{std::move(output)};
+    }
+
+    void nodeDone() {
+        if(outstanding_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->release();
+        }
+    }
+
+    std::vector<Node> nodes_;
+    std::atomic<std::size_t> outstanding_{0};
+    std::atomic<bool> settled_{false};
+};
+
+// Slots are the result type itself where it can be default constructed so that the
+// result vector is filled in place. Inputs complete concurrently, so a slot must be
+// its own object: std::vector<bool> packs bits into shared words and is avoided.
+template<class T>
+constexpr bool collect_in_place = std::is_default_constructible_v<T> && !std::is_same_v<T, bool>;
+
+template<class T>
+using CollectSlotT = std::conditional_t<collect_in_place<T>, T, std::optional<T>>;
+
+template<class T>
+std::vector<T> takeSlots(std::vector<CollectSlotT<T>>&& slots) {
+    if constexpr(collect_in_place<T>) {
+        return std::move(slots);
+    } else {
+        std::vector<T> result;
+        result.reserve(slots.size());
+        for(auto& slot : slots) {
+            result.push_back(*std::move(slot));
+        }
+        return result;
+    }
+}
+
+template<class T>
+struct CollectAllCore final : JoinCore<T, std::vector<T>> {
+    explicit CollectAllCore(std::size_t size) : slots_(size) {}
+
+    void onValue(std::size_t index, T&& value) override {
+        slots_[index] = std::move(value);
+        if(completed_.fetch_add(1, std::memory_order_acq_rel) + 1 == slots_.size() && this->settle()) {
+            this->set_value(takeSlots<T>(std::move(slots_)));
+        }
+    }
+
+    std::vector<CollectSlotT<T>> slots_;
+    std::atomic<std::size_t> completed_{0};
+};
+
+// Keeps the first n values in completion order along with the index of their input
+template<class T>
+struct CollectNCore final : JoinCore<T, std::vector<std::pair<std::size_t, T>>> {
+    using ElementT = std::pair<std::size_t, T>;
+
+    explicit CollectNCore(std::size_t n) : slots_(n) {}
+
+    void onValue(std::size_t index, T&& value) override {
+        auto slot = claimed_.fetch_add(1, std::memory_order_relaxed);
+        if(slot >= slots_.size()) {
+            return;
+        }
+        slots_[slot] = ElementT{index, std::move(value)};
+        if(filled_.fetch_add(1, std::memory_order_acq_rel) + 1 == slots_.size() && this->settle()) {
+            this->set_value(takeSlots<ElementT>(std::move(slots_)));
+        }
+    }
+
+    std::vector<CollectSlotT<ElementT>> slots_;
+    std::atomic<std::size_t> claimed_{0};
+    std::atomic<std::size_t> filled_{0};
+};
+
+// Collects every value and then folds them in input order, so the result does not
+// depend on the order in which inputs complete.
+template<class T, class R, class Op>
+struct ReduceCore final : JoinCore<T, R> {
+    ReduceCore(std::size_t size, R init, Op op) :
+        slots_(size), init_{std::move(init)}, op_{std::move(op)} {}
+
+    void onValue(std::size_t index, T&& value) override {
+        slots_[index] = std::move(value);
+        if(completed_.fetch_add(1, std::memory_order_acq_rel) + 1 == slots_.size() && this->settle()) {
+            R result = std::move(init_);
+            for(auto& slot : slots_) {
+                if constexpr(collect_in_place<T>) {
+                    result = op_(std::move(result), std::move(slot));
+                } else {
+                    result = op_(std::move(result), *std::move(slot));
+                }
+            }
+            this->set_value(std::move(result));
+        }
+    }
+
+    std::vector<CollectSlotT<T>> slots_;
+    R init_;
+    Op op_;
+    std::atomic<std::size_t> completed_{0};
+};
+
+// Future of all the values in input order, ready and empty for no futures
+template<class T>
+ContinuableFuture<std::vector<lift_unit_t<T>>> collectAll(std::vector<ContinuableFuture<T>> futures) {
+    const bool empty = futures.empty();
+    auto core = new CollectAllCore<lift_unit_t<T>>(futures.size());
+    auto result = core->attach(std::move(futures));
+    if(empty) {
+        core->set_value({});
+    }
+    return result;
+}
+
+// Future of the first n values to complete, each paired with the index of its input
+template<class T>
+ContinuableFuture<std::vector<std::pair<std::size_t, lift_unit_t<T>>>> collectN(
+        std::vector<ContinuableFuture<T>> futures, std::size_t n) {
+    if(n > futures.size()) {
+        throw std::logic_error("collectN asked for more values than there are futures");
+    }
+    auto core = new CollectNCore<lift_unit_t<T>>(n);
+    auto result = core->attach(std::move(futures));
+    if(n == 0 && core->settle()) {
+        core->set_value({});
+    }
+    return result;
+}
+
+// Future of op(...op(op(init, v0), v1)..., vN-1), ready with init for no futures
+template<class T, class R, class Op>
+ContinuableFuture<R> reduce(std::vector<ContinuableFuture<T>> futures, R init, Op op) {
+    const bool empty = futures.empty();
+    auto core = new ReduceCore<lift_unit_t<T>, R, Op>(futures.size(), std::move(init), std::move(op));
+    auto result = core->attach(std::move(futures));
+    if(empty) {
+        core->set_value(std::move(core->init_));
+    }
+    return result;
+}
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Collect.h"
+#include "Executor.h"
+#include "MyAsyncLibrary.h"
+
+int main() {
+    where("main()");
+
+    auto exec = std::make_shared<DrivenExecutor>();
+    auto t = std::thread([&](){
+            exec->run();
+        });
+
+    {
+        where("collectAll completing in reverse order");
+        constexpr int shards = 10000;
+        std::vector<Promise<int>> promises(shards);
+        std::vector<ContinuableFuture<int>> futures;
+        for(auto& p : promises) {
+            futures.push_back(p.get_future().via(exec));
+        }
+        auto all = collectAll(std::move(futures));
+        for(int i = shards - 1; i >= 0; --i) {
+            promises[i].set_value(i);
+        }
+        auto values = all.get();
+        bool inOrder = true;
+        for(int i = 0; i < shards; ++i) {
+            inOrder = inOrder && values[i] == i;
+        }
+        std::cout << "Collected " << values.size() << " values, in input order: " << inOrder << "\n";
+    }
+
+    {
+        where("collectAll of move-only values");
+        std::vector<Promise<std::unique_ptr<std::string>>> promises(3);
+        std::vector<ContinuableFuture<std::unique_ptr<std::string>>> futures;
+        for(auto& p : promises) {
+            futures.push_back(p.get_future().via(exec));
+        }
+        auto all = collectAll(std::move(futures)).then([](std::vector<std::unique_ptr<std::string>> v){
+                return *v[0] + *v[1] + *v[2];
+            });
+        promises[1].set_value(std::make_unique<std::string>("b"));
+        promises[2].set_value(std::make_unique<std::string>("c"));
+        promises[0].set_value(std::make_unique<std::string>("a"));
+        std::cout << "Joined: " << all.get() << "\n";
+    }
+
+    {
+        where("collectN");
+        std::vector<Promise<std::string>> promises(5);
+        std::vector<ContinuableFuture<std::string>> futures;
+        for(auto& p : promises) {
+            futures.push_back(p.get_future().via(exec));
+        }
+        auto firstTwo = collectN(std::move(futures), 2);
+        promises[3].set_value("three");
+        promises[1].set_value("one");
+        promises[0].set_value("zero");
+        auto values = firstTwo.get();
+        std::cout << "First two:";
+        for(auto& v : values) {
+            std::cout << " " << v.first << "=" << v.second;
+        }
+        std::cout << "\n";
+        promises[2].set_value("two");
+        promises[4].set_value("four");
+    }
+
+    {
+        where("reduce");
+        std::vector<Promise<int>> promises(100);
+        std::vector<ContinuableFuture<int>> futures;
+        for(auto& p : promises) {
+            futures.push_back(p.get_future().via(exec));
+        }
+        auto sum = reduce(std::move(futures), std::string{}, [](std::string acc, int v){
+                return acc.size() < 10 ? acc + std::to_string(v % 10) : acc;
+            });
+        for(int i = 99; i >= 0; --i) {
+            promises[i].set_value(i);
+        }
+        std::cout << "Reduced in input order: " << sum.get() << "\n";
+    }
+
+    {
+        where("collectAll of bools completing on several executors");
+        constexpr int count = 64;
+        std::vector<std::shared_ptr<DrivenExecutor>> execs;
+        std::vector<std::thread> threads;
+        for(int e = 0; e < 4; ++e) {
+            execs.push_back(std::make_shared<DrivenExecutor>());
+            threads.emplace_back([exec = execs.back()](){
+                    exec->run();
+                });
+        }
+        std::vector<Promise<bool>> promises(count);
+        std::vector<ContinuableFuture<bool>> futures;
+        for(int i = 0; i < count; ++i) {
+            futures.push_back(promises[i].get_future().via(execs[i % execs.size()]));
+        }
+        auto all = collectAll(std::move(futures));
+        for(int i = 0; i < count; ++i) {
+            promises[i].set_value(i % 3 == 0);
+        }
+        auto values = all.get();
+        bool correct = values.size() == count;
+        for(int i = 0; i < count; ++i) {
+            correct = correct && values[i] == (i % 3 == 0);
+        }
+        for(auto& e : execs) {
+            e->terminate();
+        }
+        for(auto& thread : threads) {
+            thread.join();
+        }
+        std::cout << "Collected bools, each in its own slot: " << correct << "\n";
+    }
+
+    {
+        where("collectAll and reduce of no futures");
+        auto none = collectAll(std::vector<ContinuableFuture<int>>{});
+        auto folded = reduce(std::vector<ContinuableFuture<int>>{}, 7, [](int acc, int v){ return acc + v; });
+        std::cout << "Collected " << none.get().size() << " values, reduced to init: " << folded.get() << "\n";
+    }
+
+    exec->terminate();
+    t.join();
+    std::cout << "END\n";
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Future.h"
+
+// Passes a value through unchanged. Starts each fused run of stages.
+template<class T>
+struct Identity {
+    T operator()(T value) {
+        return value;
+    }
+};
+
+template<>
+struct Identity<void> {
+    void operator()() {}
+};
+
+// Runs g on the result of f as one callable, so that both stages run in one task
+template<class F, class G>
+struct Composed {
+    template<class... Args>
+    decltype(auto) operator()(Args&&... args) {
+        if constexpr(std::is_void_v<std::invoke_result_t<F&, Args...>>) {
+            std::invoke(f_, std::forward<Args>(args)...);
+            return std::invoke(g_);
+        } else {
+            return std::invoke(g_, std::invoke(f_, std::forward<Args>(args)...));
+        }
+    }
+
+    F f_;
+    G g_;
+};
+
+template<class F>
+struct ThenStage {
+    F func_;
+};
+
+struct ViaStage {
+    std::shared_ptr<DrivenExecutor> exec_;
+};
+
+template<class T>
+struct is_then_stage : std::false_type {};
+
+template<class F>
+struct is_then_stage<ThenStage<F>> : std::true_type {};
+
+// A chain of continuations built without touching any core. When the chain is
+// attached with future(), consecutive then stages are composed at compile time into
+// a single callable that runs as one task. A via stage only costs an executor hop
+// if it names a different executor from the one the chain is already on.
+template<class T, class... Stages>
+class DeferredFuture {
+public:
+    DeferredFuture(ContinuableFuture<T>&& source, std::tuple<Stages...>&& stages) :
+        source_{std::move(source)}, stages_{std::move(stages)} {}
+
+    template<class F>
+    DeferredFuture<T, Stages..., ThenStage<std::decay_t<F>>> then(F&& callback) && {
+        return {
+            std::move(source_),
+            std::tuple_cat(std::move(stages_), std::make_tuple(ThenStage<std::decay_t<F>>{std::forward<F>(callback)}))};
+    }
+
+    DeferredFuture<T, Stages..., ViaStage> via(std::shared_ptr<DrivenExecutor> exec) && {
+        return {
+            std::move(source_),
+            std::tuple_cat(std::move(stages_), std::make_tuple(ViaStage{std::move(exec)}))};
+    }
+
+    // Attach the chain to the source future
+    auto future() && {
+        auto exec = source_.getExecutor();
+        return attach<0>(std::move(source_), Identity<T>{}, exec);
+    }
+
+private:
+    // pending holds the stages since the last hop, to be run as one task on current
+    template<std::size_t I, class U, class Pending>
+    auto attach(ContinuableFuture<U>&& future, Pending&& pending, const std::shared_ptr<DrivenExecutor>& current) {
+        constexpr bool nothingPending = std::is_same_v<std::decay_t<Pending>, Identity<U>>;
+        if constexpr(I == sizeof...(Stages)) {
+            if constexpr(nothingPending) {
+                return std::move(future);
+            } else {
+                return future.then(std::forward<Pending>(pending));
+            }
+        } else {
+            auto& stage = std::get<I>(stages_);
+            if constexpr(is_then_stage<std::decay_t<decltype(stage)>>::value) {
+                using F = decltype(stage.func_);
+                if constexpr(nothingPending) {
+                    return attach<I + 1>(std::move(future), std::move(stage.func_), current);
+                } else {
+                    return attach<I + 1>(
+                        std::move(future),
+                        Composed<std::decay_t<Pending>, F>{std::forward<Pending>(pending), std::move(stage.func_)},
+                        current);
+                }
+            } else {
+                if(stage.exec_ == current) {
+                    return attach<I + 1>(std::move(future), std::forward<Pending>(pending), current);
+                }
+                // Run what is pending where we are and continue on the new executor
+                if constexpr(nothingPending) {
+                    return attach<I + 1>(future.via(stage.exec_), Identity<U>{}, stage.exec_);
+                } else {
+                    auto next = future.then(std::forward<Pending>(pending));
+                    using R = typename decltype(next)::ValueT;
+                    return attach<I + 1>(next.via(stage.exec_), Identity<R>{}, stage.exec_);
+                }
+            }
+        }
+    }
+
+    ContinuableFuture<T> source_;
+    std::tuple<Stages...> stages_;
+};
+
+// Start a deferred chain of continuations on future
+template<class T>
+DeferredFuture<T> defer(ContinuableFuture<T> future) {
+    return {std::move(future), std::tuple<>{}};
+}
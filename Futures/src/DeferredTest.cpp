@@ -0,0 +1,72 @@
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "Deferred.h"
+#include "Executor.h"
+#include "MyAsyncLibrary.h"
+
+int main() {
+    where("main()");
+
+    auto exec1 = std::make_shared<DrivenExecutor>();
+    auto exec2 = std::make_shared<DrivenExecutor>();
+    auto t1 = std::thread([&](){
+            exec1->run();
+        });
+    auto t2 = std::thread([&](){
+            exec2->run();
+        });
+
+    {
+        where("Fused stages with one hop");
+        Promise<int> p;
+        std::thread::id ids[5];
+        // Queued on exec1 by the first stage. Only runs between stages if they hop.
+        std::atomic<bool> markerRan = false;
+        bool fused = true;
+        auto f = defer(p.get_future().via(exec1))
+            .then([&](int v){
+                ids[0] = std::this_thread::get_id();
+                exec1->execute([&](){ markerRan = true; });
+                return v + 1;
+            })
+            .then([&](int v){ ids[1] = std::this_thread::get_id(); return std::to_string(v); })
+            .via(exec1)
+            .then([&](std::string s){
+                ids[2] = std::this_thread::get_id();
+                fused = !markerRan;
+                return s + "!";
+            })
+            .via(exec2)
+            .then([&](std::string s){ ids[3] = std::this_thread::get_id(); return s.size(); })
+            .then([&](std::size_t n){ ids[4] = std::this_thread::get_id(); (void)n; })
+            .future();
+        p.set_value(41);
+        f.get();
+        std::cout << "Stages before via(exec2) fused into one task: " << fused
+                  << ", on exec1: " << (ids[0] == t1.get_id() && ids[1] == ids[0] && ids[2] == ids[0])
+                  << ", after via(exec2) on exec2: " << (ids[3] == t2.get_id() && ids[4] == ids[3]) << "\n";
+    }
+
+    {
+        where("Deferred chain of move-only values");
+        Promise<std::unique_ptr<int>> p;
+        auto f = defer(p.get_future().via(exec1))
+            .then([](std::unique_ptr<int> v){ *v += 1; return v; })
+            .via(exec2)
+            .then([](std::unique_ptr<int> v){ return *v * 2; })
+            .future();
+        p.set_value(std::make_unique<int>(20));
+        std::cout << "Result: " << f.get() << "\n";
+    }
+
+    exec1->terminate();
+    exec2->terminate();
+    t1.join();
+    t2.join();
+    std::cout << "END\n";
+
+    return 0;
+}
@@ -3,6 +3,8 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <utility>
+#include <vector>
 #include <iostream>
 
 class DrivenExecutor {
@@ -15,8 +17,24 @@ class DrivenExecutor {
             cv_.notify_all();
         }
 
+        // Add a group of tasks under a single lock acquisition and notify
+        void executeBatch(std::vector<std::function<void()>> tasks) {
+            std::unique_lock<std::mutex> lock(queueLock_);
+            for(auto& task : tasks) {
+                tasks_.push(std::move(task));
+            }
+            
+            cv_.notify_all();
+        }
+
+        // Executor whose run is active on the calling thread, or null
+        static DrivenExecutor* current() {
+            return currentSlot();
+        }
+
         // Run, blocking the calling thread until terminate is called
         void run() {
+            auto previous = std::exchange(currentSlot(), this);
             while(terminateAfter_ != 0) {
                 std::function<void()> nextFunction;
                 {
@@ -36,6 +54,7 @@ class DrivenExecutor {
                     nextFunction();
                 }
             }
+            currentSlot() = previous;
         }
 
         // Terminate soon. Will drain events already in the queue before
@@ -47,6 +66,11 @@ class DrivenExecutor {
         }
 
     private:
+        static DrivenExecutor*& currentSlot() {
+            thread_local DrivenExecutor* current = nullptr;
+            return current;
+        }
+
         std::queue<std::function<void()>> tasks_;
         std::atomic<int> terminateAfter_{-1};
         std::mutex queueLock_;
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+// The same private interface that libc++ uses to implement std::atomic::wait
+extern "C" int __ulock_wait(std::uint32_t operation, void* addr, std::uint64_t value, std::uint32_t timeout);
+extern "C" int __ulock_wake(std::uint32_t operation, void* addr, std::uint64_t wakeValue);
+#endif
+
+using FutexClock = std::chrono::steady_clock;
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Block while word holds expected, until woken or deadline passes (null for no deadline).
+// Like the underlying system calls this may return spuriously so callers re-check word.
+inline void futexWait(
+        std::atomic<std::uint32_t>& word, std::uint32_t expected, const FutexClock::time_point* deadline) {
+    std::chrono::nanoseconds timeout{0};
+    if(deadline) {
+        timeout = *deadline - FutexClock::now();
+        if(timeout <= std::chrono::nanoseconds{0}) {
+            return;
+        }
+    }
+#if defined(__linux__)
+    timespec ts;
+    ts.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(timeout).count();
+    ts.tv_nsec = (timeout - std::chrono::seconds{ts.tv_sec}).count();
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected,
+        deadline ? &ts : nullptr, nullptr, 0);
+#elif defined(__APPLE__)
+    constexpr std::uint32_t compareAndWait = 1;
+    // Zero means wait forever so round short timeouts up
+    std::uint32_t us = 0;
+    if(deadline) {
+        auto count = std::chrono::duration_cast<std::chrono::microseconds>(timeout).count() + 1;
+        us = count > UINT32_MAX ? UINT32_MAX : static_cast<std::uint32_t>(count);
+    }
+    __ulock_wait(compareAndWait, &word, expected, us);
+#else
+    // No futex available so back off with a short sleep instead
+    if(word.load(std::memory_order_acquire) == expected) {
+        auto sleep = std::chrono::nanoseconds{std::chrono::microseconds{100}};
+        std::this_thread::sleep_for(deadline && timeout < sleep ? timeout : sleep);
+    }
+#endif
+}
+
+inline void futexWakeAll(std::atomic<std::uint32_t>& word) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX,
+        nullptr, nullptr, 0);
+#elif defined(__APPLE__)
+    constexpr std::uint32_t compareAndWaitWakeAll = 1 | 0x100;
+    __ulock_wake(compareAndWaitWakeAll, &word, 0);
+#else
+    (void)word;
+#endif
+}
+
+// One-shot event. Waiters spin briefly in case the post is imminent and then park
+// on a futex, so there is no mutex or condition variable and post is a single store
+// unless somebody is parked.
+class Baton {
+public:
+    void post() {
+        state_.store(1);
+        if(waiters_.load() != 0) {
+            futexWakeAll(state_);
+        }
+    }
+
+    bool ready() const {
+        return state_.load(std::memory_order_acquire) != 0;
+    }
+
+    void wait() {
+        waitUntil(nullptr);
+    }
+
+    // Returns false if the deadline passed before post
+    bool waitUntil(const FutexClock::time_point* deadline) {
+        for(int i = 0; i < spinCount; ++i) {
+            if(ready()) {
+                return true;
+            }
+            cpuRelax();
+        }
+
+        waiters_.fetch_add(1);
+        while(state_.load() == 0) {
+            if(deadline && FutexClock::now() >= *deadline) {
+                break;
+            }
+            futexWait(state_, 0, deadline);
+        }
+        waiters_.fetch_sub(1);
+        return ready();
+    }
+
+private:
+    static constexpr int spinCount = 1000;
+
+    std::atomic<std::uint32_t> state_{0};
+    std::atomic<std::uint32_t> waiters_{0};
+};
@@ -1,147 +1,524 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
 #include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "SimpleAwaitable.h"
 #include "AsyncAwait.h"
 #include "MyAsyncLibrary.h"
+#include "Futex.h"
 
-struct VirtualAwaitable {
-    ~VirtualAwaitable() {}
-    virtual bool await_ready() = 0;
-    virtual void await_suspend(std::experimental::coroutine_handle<>) = 0;
-    virtual void await_resume() = 0;
+// Cores cannot store void so a future of void stores a Unit instead
+struct Unit {};
+
+template<class T>
+struct lift_unit {
+    using type = T;
 };
 
-template<class AwaitableT> 
-struct VirtualAwaitableImpl : public VirtualAwaitable {
-    VirtualAwaitableImpl(AwaitableT& awaitable) : awaitable_{awaitable} {}
-    bool await_ready() override {
-        return awaitable_.await_ready();
+template<>
+struct lift_unit<void> {
+    using type = Unit;
+};
+
+template<class T>
+using lift_unit_t = typename lift_unit<T>::type;
+
+// Result of calling a continuation on a T, where a void T means no argument
+template<class F, class T>
+struct then_result {
+    using type = std::invoke_result_t<F, T>;
+};
+
+template<class F>
+struct then_result<F, void> {
+    using type = std::invoke_result_t<F>;
+};
+
+template<class F, class T>
+using then_result_t = typename then_result<F, T>::type;
+
+// Callback stored in a core, run on the core's executor once the value is available.
+// Templated continuations derive from this so that the core does not need a std::function.
+// A continuation manages its own lifetime: the core calls exactly one of run or discard.
+template<class T>
+struct Continuation {
+    virtual void run(T&& value) = 0;
+    // Called instead of run when the core completes with an exception
+    virtual void fail(std::exception_ptr error) = 0;
+    // Called instead of run when the core is destroyed without a value
+    virtual void discard() = 0;
+
+protected:
+    ~Continuation() {}
+};
+
+template<class T>
+struct AwaitableOps;
+
+template<class T>
+struct ValueCore;
+
+// Base of the two kinds of core. The kind is fixed at construction so the operations
+// below test it and call ValueCore directly, which lets the compiler inline the
+// promise path. Awaitable cores, whose awaitable type is erased, go through a static
+// table of functions instead. The destructor is the only virtual call, made once.
+template<class T>
+struct CoreBase {
+    enum class Kind : std::uint8_t {
+        Value,
+        Awaitable
+    };
+
+    explicit CoreBase(Kind kind) : kind_{kind} {}
+    virtual ~CoreBase() {}
+
+    T get();
+    // Block until the value is available or deadline passes (null for no deadline)
+    bool waitUntil(const FutexClock::time_point* deadline);
+    void setCallback(Continuation<T>* callback);
+    // As above but run callback on target, which may differ from the core's executor.
+    // A value core's executor becomes target, so getExecutor returns target after.
+    void setCallback(Continuation<T>* callback, std::shared_ptr<DrivenExecutor> target);
+
+    // The executor is set by via before any callback so needs no synchronization
+    void setExecutor(std::shared_ptr<DrivenExecutor> exec) {
+        exec_ = std::move(exec);
+    }
+
+    std::shared_ptr<DrivenExecutor> getExecutor() {
+        return exec_;
     }
 
-    void await_suspend(std::experimental::coroutine_handle<> h) override {
-        awaitable_.await_suspend(h);
+    bool isAwaitable() const {
+        return kind_ == Kind::Awaitable;
     }
 
-    void await_resume() override {
-        awaitable_.await_resume();
+    ValueCore<T>* asValueCore() {
+        return static_cast<ValueCore<T>*>(this);
     }
 
-    AwaitableT& awaitable_;
+    // Intrusive reference count shared by promises, futures and queued tasks
+    void acquire() {
+        refCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() {
+        if(refCount_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    std::atomic<int> refCount_{0};
+    std::shared_ptr<DrivenExecutor> exec_;
+    const Kind kind_;
+    // Only set for awaitable cores
+    const AwaitableOps<T>* ops_ = nullptr;
 };
 
 template<class T>
-struct CoreBase {
-    virtual ~CoreBase() {}
-    virtual T get() = 0;
-    virtual void setExecutor(std::shared_ptr<DrivenExecutor> exec) = 0;
-    virtual std::shared_ptr<DrivenExecutor> getExecutor() = 0;
-    virtual void setCallback(std::function<void(T)>) = 0;
-    virtual bool isAwaitable() = 0;
-    virtual VirtualAwaitable& getAwaitable() = 0;
+struct AwaitableOps {
+    T (*get)(CoreBase<T>*);
+    bool (*waitUntil)(CoreBase<T>*, const FutexClock::time_point*);
+    void (*setCallback)(CoreBase<T>*, Continuation<T>*, std::shared_ptr<DrivenExecutor>);
+};
+
+// Coroutine started by a core to drive an awaitable. It is not awaited by anything
+// and frees its own frame when it completes.
+struct DetachedTask {
+    struct promise_type;
+    using handle = std::experimental::coroutine_handle<promise_type>;
+
+    struct promise_type {
+        // Executor that awaitables resume this coroutine on
+        std::shared_ptr<DrivenExecutor> executor;
+
+        auto initial_suspend() {
+            return std::experimental::suspend_always{};
+        }
+
+        auto final_suspend() {
+            return std::experimental::suspend_never{};
+        }
+
+        void return_void() {}
+
+        auto get_return_object() {
+            return DetachedTask{handle::from_promise(*this)};
+        }
+
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+
+    handle coroutine_handle_;
+};
+
+// Continue on exec, inline if the coroutine is already running there
+struct ResumeOn {
+    bool await_ready() {
+        return DrivenExecutor::current() == exec_.get();
+    }
+
+    void await_suspend(std::experimental::coroutine_handle<> h) {
+        exec_->execute([h](){ h.resume(); });
+    }
+
+    void await_resume() {}
 
     std::shared_ptr<DrivenExecutor> exec_;
 };
 
-// This core wraps an arbitrary Awaitable into a future without a promise involved
-// This might be one option for hiding a communication-style future from an asynchronous programming future
-// but more efficiently so that co_await works well with it only dependent on virtual function calls except
-// where synchronization is absolutely necessary.
+// Await awaitable and run cb with its value on target. An awaitable that completes
+// inline, like ZeroOverheadAwaitable, chains straight into cb when it was started on
+// target; one that resumes its waiter elsewhere costs a single transfer to target.
 template<class T, class AwaitableT>
-struct AwaitableCore : CoreBase<T> {
-    AwaitableCore(AwaitableT&& awaitable) : awaitable_(std::move(awaitable)), vAwaitable_{awaitable_} {}
+DetachedTask awaitInto(AwaitableT awaitable, std::shared_ptr<DrivenExecutor> target, Continuation<T>* cb) {
+    T value = co_await std::move(awaitable);
+    ResumeOn resume{std::move(target)};
+    co_await resume;
+    cb->run(std::move(value));
+}
+
+// Owning handle to a core using the core's own reference count so that there is no
+// separate control block to allocate or touch on copy.
+template<class CoreT>
+class CorePtr {
+public:
+    CorePtr() = default;
 
-    T get() override {
-        return sync_await(std::move(awaitable_));
+    explicit CorePtr(CoreT* core) : core_{core} {
+        if(core_) {
+            core_->acquire();
+        }
     }
 
-    void setExecutor(std::shared_ptr<DrivenExecutor> exec) override {
-        this->exec_ = std::move(exec);
+    CorePtr(const CorePtr& rhs) : CorePtr{rhs.core_} {}
+
+    CorePtr(CorePtr&& rhs) : core_{std::exchange(rhs.core_, nullptr)} {}
+
+    template<class OtherT, class = std::enable_if_t<std::is_convertible_v<OtherT*, CoreT*>>>
+    CorePtr(const CorePtr<OtherT>& rhs) : CorePtr{rhs.get()} {}
+
+    template<class OtherT, class = std::enable_if_t<std::is_convertible_v<OtherT*, CoreT*>>>
+    CorePtr(CorePtr<OtherT>&& rhs) : core_{rhs.detach()} {}
+
+    ~CorePtr() {
+        if(core_) {
+            core_->release();
+        }
     }
 
-    void setCallback(std::function<void(T)> cb) override {
-        async_await(this->exec_, std::move(awaitable_), std::move(cb));
+    CorePtr& operator=(CorePtr rhs) {
+        std::swap(core_, rhs.core_);
+        return *this;
     }
- 
-    std::shared_ptr<DrivenExecutor> getExecutor() override {
-        return this->exec_;
+
+    CoreT* get() const {
+        return core_;
     }
 
-    bool isAwaitable() override {
+    CoreT* operator->() const {
+        return core_;
+    }
+
+    explicit operator bool() const {
+        return core_ != nullptr;
+    }
+
+    // Give up ownership of the reference without releasing it
+    CoreT* detach() {
+        return std::exchange(core_, nullptr);
+    }
+
+private:
+    CoreT* core_ = nullptr;
+};
+
+// This core wraps an arbitrary Awaitable into a future without a promise involved
+// This might be one option for hiding a communication-style future from an asynchronous programming future
+// but more efficiently so that co_await works well with it only dependent on calls through its table of
+// operations except where synchronization is absolutely necessary.
+template<class T, class AwaitableT>
+struct AwaitableCore : CoreBase<T> {
+    AwaitableCore(AwaitableT&& awaitable) :
+        CoreBase<T>{CoreBase<T>::Kind::Awaitable}, awaitable_(std::move(awaitable)) {
+        this->ops_ = &ops;
+    }
+
+    T get() {
+        waitUntil(nullptr);
+        return *std::move(value_);
+    }
+
+    // The awaitable is driven on the calling thread so this cannot time out
+    bool waitUntil(const FutexClock::time_point*) {
+        if(!value_) {
+            value_ = sync_await(std::move(awaitable_));
+        }
         return true;
     }
 
-    VirtualAwaitable& getAwaitable() override {
-        return vAwaitable_;
+    // The awaitable is started on this core's executor and the coroutine driving it
+    // asks to be resumed on target, so no task is spent getting back to it
+    void setCallback(Continuation<T>* cb, std::shared_ptr<DrivenExecutor> target) {
+        if(!target) {
+            throw std::logic_error("Setting a callback without an executor is invalid");
+        }
+        auto source = this->exec_ ? this->exec_ : target;
+        auto task = awaitInto<T>(std::move(awaitable_), target, cb);
+        task.coroutine_handle_.promise().executor = std::move(target);
+        source->execute([h = task.coroutine_handle_](){ h.resume(); });
+    }
+
+    static AwaitableCore* self(CoreBase<T>* core) {
+        return static_cast<AwaitableCore*>(core);
     }
 
+    static inline const AwaitableOps<T> ops{
+        [](CoreBase<T>* core) { return self(core)->get(); },
+        [](CoreBase<T>* core, const FutexClock::time_point* deadline) { return self(core)->waitUntil(deadline); },
+        [](CoreBase<T>* core, Continuation<T>* cb, std::shared_ptr<DrivenExecutor> target) {
+            self(core)->setCallback(cb, std::move(target));
+        }};
+
     AwaitableT awaitable_;
-    VirtualAwaitableImpl<AwaitableT> vAwaitable_;
+    std::optional<T> value_;
 };
 
+// Core shared by a promise and its future. Value and callback race to arrive through
+// a lock-free state machine; whichever arrives second enqueues the callback. Blocking
+// gets wait on a baton rather than a mutex and condition variable. An exception takes
+// the place of the value and is rethrown by get or passed to the callback's fail.
 template<class T>
 struct ValueCore : CoreBase<T> {
-    T get() override {
-        std::lock_guard<std::mutex> lg{mtx_};
-        if(!value_) {
-            throw std::logic_error("Value not set on promise");
+    enum State : std::uint32_t {
+        Start,
+        OnlyValue,
+        OnlyCallback,
+        Done
+    };
+
+    ValueCore() : CoreBase<T>{CoreBase<T>::Kind::Value} {}
+
+    ~ValueCore() override {
+        if(callback_) {
+            callback_->discard();
+        }
+    }
+
+    T get() {
+        waitUntil(nullptr);
+        if(exception_) {
+            std::rethrow_exception(exception_);
+        }
+        if(state_.load(std::memory_order_acquire) != OnlyValue) {
+            throw std::logic_error("Value already consumed by a callback");
         }
         return *std::move(value_);
     }
 
-    void set_value(T value) {
-        std::lock_guard<std::mutex> lg{mtx_};
-        if(callback_) {
-            if(!this->exec_) {
-                throw std::logic_error("Callback set but executor not set.");
-            }
-            this->exec_->execute([cb = std::move(callback_), val = std::move(value)](){
-                cb(std::move(val));
-            });
-        } else {
-            value_ = std::move(value);
+    bool waitUntil(const FutexClock::time_point* deadline) {
+        return valueSet_.waitUntil(deadline);
+    }
+
+    // Taken by rvalue reference so that a large value is moved once, into the core
+    void set_value(T&& value) {
+        if(publish(std::move(value))) {
+            enqueueCallback();
         }
     }
 
-    void setExecutor(std::shared_ptr<DrivenExecutor> exec) override {         
-        std::lock_guard<std::mutex> lg{mtx_};
-        this->exec_ = std::move(exec);
+    void set_exception(std::exception_ptr error) {
+        if(publishException(std::move(error))) {
+            enqueueCallback();
+        }
+    }
+
+    // Store the value and wake blocked getters. Returns true if a callback had already
+    // arrived, in which case the caller must enqueue it.
+    bool publish(T&& value) {
+        value_.emplace(std::move(value));
+        return publishResult();
+    }
+
+    bool publishException(std::exception_ptr error) {
+        exception_ = std::move(error);
+        return publishResult();
     }
- 
-    std::shared_ptr<DrivenExecutor> getExecutor() override {
-        std::lock_guard<std::mutex> lg{mtx_};
-        return this->exec_;
+
+    bool publishResult() {
+        fulfilled_ = true;
+        auto state = state_.load(std::memory_order_acquire);
+        if(state == Start &&
+           state_.compare_exchange_strong(state, OnlyValue, std::memory_order_acq_rel)) {
+            valueSet_.post();
+            return false;
+        }
+        // The callback arrived first
+        state_.store(Done, std::memory_order_release);
+        valueSet_.post();
+        return true;
     }
 
-    void setCallback(std::function<void(T)> callback) override {
-        std::lock_guard<std::mutex> lg{mtx_};
+    void setCallback(Continuation<T>* callback) {
         if(!this->exec_) {
             throw std::logic_error("Setting a callback without an executor is invalid");
         }
-        if(value_) {
-            // Promise already satisfied so enqueue a callback that captures the value
-            this->exec_->execute([val = *std::move(value_), cb = std::move(callback)](){
-                    cb(std::move(val));
-                });
-        } else {
-            // Promise not already satisfied to just store the callback
-            callback_ = std::move(callback);
+        callback_ = callback;
+        auto state = state_.load(std::memory_order_acquire);
+        if(state == Start &&
+           state_.compare_exchange_strong(state, OnlyCallback, std::memory_order_acq_rel)) {
+            // Stored until set_value
+            return;
         }
+        // Promise already satisfied so enqueue the callback immediately
+        state_.store(Done, std::memory_order_release);
+        enqueueCallback();
+    }
+
+    // The task keeps the core alive and moves the value out of the core when it runs,
+    // so the task itself stays copyable whatever T is. The reference is carried as a raw
+    // pointer so that the task fits in std::function's small buffer.
+    // Called once both value and callback are present.
+    void enqueueCallback() {
+        this->exec_->execute(makeTask());
     }
 
-    bool isAwaitable() override {
-        return false;
+    std::function<void()> makeTask() {
+        this->acquire();
+        return [core = this](){
+            core->runCallback();
+            core->release();
+        };
     }
 
-    VirtualAwaitable& getAwaitable() override {
-        // TODO: Maybe this does make sense and we can construct one by value?
-        throw std::logic_error("makes no sense for this path");
+    void runCallback() {
+        if(exception_) {
+            std::exchange(callback_, nullptr)->fail(exception_);
+        } else {
+            std::exchange(callback_, nullptr)->run(*std::move(value_));
+        }
     }
 
-    std::mutex mtx_;
+    std::atomic<std::uint32_t> state_{Start};
+    Baton valueSet_;
     std::optional<T> value_;
-    std::function<void(T)> callback_;
+    std::exception_ptr exception_;
+    Continuation<T>* callback_ = nullptr;
+    // Written only by the producer, so that a promise knows whether it was kept
+    bool fulfilled_ = false;
+};
+
+template<class T>
+T CoreBase<T>::get() {
+    if(kind_ == Kind::Value) {
+        return asValueCore()->get();
+    }
+    return ops_->get(this);
+}
+
+template<class T>
+bool CoreBase<T>::waitUntil(const FutexClock::time_point* deadline) {
+    if(kind_ == Kind::Value) {
+        return asValueCore()->waitUntil(deadline);
+    }
+    return ops_->waitUntil(this, deadline);
+}
+
+template<class T>
+void CoreBase<T>::setCallback(Continuation<T>* callback) {
+    if(kind_ == Kind::Value) {
+        asValueCore()->setCallback(callback);
+    } else {
+        ops_->setCallback(this, callback, exec_);
+    }
+}
+
+template<class T>
+void CoreBase<T>::setCallback(Continuation<T>* callback, std::shared_ptr<DrivenExecutor> target) {
+    if(kind_ == Kind::Value) {
+        // The callback is enqueued on the core's executor when the value arrives, so
+        // pointing that at target makes the one transfer needed
+        if(exec_ != target) {
+            exec_ = std::move(target);
+        }
+        asValueCore()->setCallback(callback);
+    } else {
+        ops_->setCallback(this, callback, std::move(target));
+    }
+}
+
+// Awaiter returned by co_await on a future. It lives in the awaiting coroutine's
+// frame and is registered directly as the core's continuation, so suspending costs
+// no allocation. The core is moved onto the coroutine's executor first so that the
+// coroutine is resumed there by the core's own task, with no second hop.
+template<class T>
+class FutureAwaiter final : Continuation<lift_unit_t<T>> {
+public:
+    using StorageT = lift_unit_t<T>;
+
+    FutureAwaiter(std::optional<StorageT>&& value, CorePtr<CoreBase<StorageT>>&& core) :
+        ready_{std::move(value)}, core_{std::move(core)} {}
+
+    bool await_ready() {
+        return ready_.has_value();
+    }
+
+    template<class PromiseT>
+    void await_suspend(std::experimental::coroutine_handle<PromiseT> h) {
+        if(!core_) {
+            throw std::logic_error("Incomplete future");
+        }
+        handle_ = h;
+        if(std::shared_ptr<DrivenExecutor> exec = h.promise().executor) {
+            core_->setExecutor(std::move(exec));
+        }
+        core_->setCallback(this);
+    }
+
+    T await_resume() {
+        if(error_) {
+            std::rethrow_exception(error_);
+        }
+        if constexpr(!std::is_void_v<T>) {
+            return ready_ ? *std::move(ready_) : std::move(*value_);
+        }
+    }
+
+private:
+    // The value stays in the core, which outlives the resumed coroutine's call to
+    // await_resume, so it is moved exactly once into the coroutine.
+    void run(StorageT&& value) override {
+        value_ = &value;
+        handle_.resume();
+    }
+
+    // The exception is rethrown into the coroutine by await_resume
+    void fail(std::exception_ptr error) override {
+        error_ = std::move(error);
+        handle_.resume();
+    }
+
+    // The core was destroyed without a value so the coroutine is never resumed
+    void discard() override {}
+
+    std::optional<StorageT> ready_;
+    CorePtr<CoreBase<StorageT>> core_;
+    StorageT* value_ = nullptr;
+    std::exception_ptr error_;
+    std::experimental::coroutine_handle<> handle_;
 };
 
 template<class T>
@@ -149,114 +526,459 @@ class Future;
 
 template<class T>
 Future<T> make_future(T);
+Future<void> make_future();
 template<class T, class AwaitableT>
 Future<T> make_awaitable_future(AwaitableT);
 
 
+class PromiseBatch;
+
 template<class T>
 class Promise {
 public:
-    Promise() : core_{std::make_shared<ValueCore<T>>()} {
+    using StorageT = lift_unit_t<T>;
+
+    Promise() : core_{new ValueCore<StorageT>} {
     }
 
-    void set_value(T value) {
+    Promise(Promise&&) = default;
+
+    Promise& operator=(Promise&& rhs) {
+        if(this != &rhs) {
+            breakPromise();
+            core_ = std::move(rhs.core_);
+        }
+        return *this;
+    }
+
+    // A promise destroyed before it is kept completes its future with broken_promise,
+    // so that a waiter or continuation is not left waiting forever
+    ~Promise() {
+        breakPromise();
+    }
+
+    void set_value(StorageT&& value) {
         core_->set_value(std::move(value));
     }
 
+    void set_value(const StorageT& value) {
+        core_->set_value(StorageT(value));
+    }
+
+    template<class U = T, std::enable_if_t<std::is_void_v<U>, int> = 0>
+    void set_value() {
+        core_->set_value(Unit{});
+    }
+
+    void set_exception(std::exception_ptr error) {
+        core_->set_exception(std::move(error));
+    }
+
     Future<T> get_future() {
-        return Future<T>{std::shared_ptr<CoreBase<T>>{core_}};
+        return Future<T>{CorePtr<CoreBase<StorageT>>{core_}};
     }
 
 private:
-    std::shared_ptr<ValueCore<T>> core_;
+    friend class PromiseBatch;
+
+    void breakPromise() {
+        if(core_ && !core_->fulfilled_) {
+            core_->set_exception(std::make_exception_ptr(std::future_error{std::future_errc::broken_promise}));
+        }
+    }
+
+    CorePtr<ValueCore<StorageT>> core_;
 };
 
 template<class T>
 class ContinuableFuture;
 
+template<class T>
+class SharedFuture;
+
+template<class T, class Result>
+struct JoinCore;
+
 template<class T>
 class Future {
 public:
+    using StorageT = lift_unit_t<T>;
+
     T get() {
         if(value_) {
-            return *std::move(value_);
+            if constexpr(std::is_void_v<T>) {
+                return;
+            } else {
+                return *std::move(value_);
+            }
         }
         if(core_) {
-            return core_->get();
+            if constexpr(std::is_void_v<T>) {
+                core_->get();
+                return;
+            } else {
+                return core_->get();
+            }
         }
         throw std::logic_error("Incomplete future");
     }
+
+    void wait() {
+        wait_until(FutexClock::time_point::max());
+    }
+
+    template<class Rep, class Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period>& duration) {
+        return wait_until(FutexClock::now() + duration);
+    }
+
+    template<class Clock, class Duration>
+    std::future_status wait_until(const std::chrono::time_point<Clock, Duration>& timePoint) {
+        if(value_) {
+            return std::future_status::ready;
+        }
+        if(!core_) {
+            throw std::logic_error("Incomplete future");
+        }
+        bool ready;
+        if(timePoint == std::chrono::time_point<Clock, Duration>::max()) {
+            ready = core_->waitUntil(nullptr);
+        } else {
+            auto deadline = FutexClock::now() +
+                std::chrono::duration_cast<FutexClock::duration>(timePoint - Clock::now());
+            ready = core_->waitUntil(&deadline);
+        }
+        return ready ? std::future_status::ready : std::future_status::timeout;
+    }
     
     // TODO: via should check if the core is an Awaitable or SemiAwaitable, if the latter 
     // the via call should forward to the core.
     ContinuableFuture<T> via(std::shared_ptr<DrivenExecutor>);
 
+    // Suspend the awaiting coroutine until the value is available and resume it on
+    // the coroutine's executor. Consumes the future.
+    FutureAwaiter<T> operator co_await() && {
+        return {std::move(value_), std::move(core_)};
+    }
+
 private:
     // Construct a future from a core
-    Future(std::shared_ptr<CoreBase<T>> core) : core_(std::move(core)) {
+    Future(CorePtr<CoreBase<StorageT>> core) : core_(std::move(core)) {
     }
 
     // Construct a ready future from a value
-    Future(T value) : value_{std::move(value)} {}
+    Future(StorageT value) : value_{std::move(value)} {}
 
     template<class FriendT> friend 
     Future<FriendT> make_future(FriendT);
+    friend Future<void> make_future();
     template<class FriendT, class AwaitableT> friend
     Future<FriendT> make_awaitable_future(AwaitableT);
     friend class Promise<T>;
 
-    std::optional<T> value_;
-    std::shared_ptr<CoreBase<T>> core_;
+    std::optional<StorageT> value_;
+    CorePtr<CoreBase<StorageT>> core_;
+};
+
+// Core of the future returned by then, which is also the continuation of the future
+// then was called on. Holding the callback inline means a then step is one allocation.
+template<class T, class R, class F>
+struct ThenCore : ValueCore<lift_unit_t<R>>, Continuation<lift_unit_t<T>> {
+    template<class CallbackT>
+    ThenCore(CallbackT&& callback) : func_{std::forward<CallbackT>(callback)} {}
+
+    // An exception from the callback completes this core with it
+    void run(lift_unit_t<T>&& value) override {
+        try {
+            if constexpr(std::is_void_v<R>) {
+                invoke(std::move(value));
+                this->set_value(Unit{});
+            } else {
+                this->set_value(invoke(std::move(value)));
+            }
+        } catch(...) {
+            this->set_exception(std::current_exception());
+        }
+        // Drop the reference held by the previous core
+        this->release();
+    }
+
+    // The callback is skipped and the exception passed on
+    void fail(std::exception_ptr error) override {
+        this->set_exception(std::move(error));
+        this->release();
+    }
+
+    void discard() override {
+        this->release();
+    }
+
+    decltype(auto) invoke(lift_unit_t<T>&& value) {
+        if constexpr(std::is_void_v<T>) {
+            return std::invoke(func_);
+        } else {
+            return std::invoke(func_, std::move(value));
+        }
+    }
+
+    F func_;
+};
+
+// Core of the future returned by bulk_then. Once the value arrives the shape is cut
+// into one contiguous block per executor. Each block runs body(value, i, shared) for
+// its indices and whichever block finishes last runs the result selector on the
+// shared state and completes this core. As for then, an exception from any of the
+// callbacks completes this core with it. The first exception is kept and blocks that
+// have not started yet skip their indices.
+template<class T, class R, class Body, class ShapeF, class SharedF, class SelectorF>
+struct BulkCore : ValueCore<lift_unit_t<R>>, Continuation<lift_unit_t<T>> {
+    using SharedT = std::invoke_result_t<SharedF&, int, const lift_unit_t<T>&>;
+
+    template<class BodyArg, class ShapeArg, class SharedArg, class SelectorArg>
+    BulkCore(
+            std::vector<std::shared_ptr<DrivenExecutor>> executors,
+            BodyArg&& body, ShapeArg&& shapeF, SharedArg&& sharedF, SelectorArg&& selectorF) :
+        executors_{std::move(executors)},
+        body_{std::forward<BodyArg>(body)},
+        shapeF_{std::forward<ShapeArg>(shapeF)},
+        sharedF_{std::forward<SharedArg>(sharedF)},
+        selectorF_{std::forward<SelectorArg>(selectorF)} {}
+
+    void run(lift_unit_t<T>&& value) override {
+        value_.emplace(std::move(value));
+        int shape = 0;
+        try {
+            shape = shapeF_(std::as_const(*value_));
+            shared_.emplace(sharedF_(shape, std::as_const(*value_)));
+        } catch(...) {
+            fail(std::current_exception());
+            return;
+        }
+        const int blocks = static_cast<int>(executors_.size());
+        if(shape <= 0) {
+            finish();
+            return;
+        }
+        // In 64 bits, as a shape near INT_MAX would overflow an int
+        const std::int64_t blockSize = (std::int64_t{shape} + blocks - 1) / blocks;
+        remaining_ = static_cast<int>((shape + blockSize - 1) / blockSize);
+        for(int begin = 0, block = 0; begin < shape; ++block) {
+            const int end = static_cast<int>(std::min<std::int64_t>(begin + blockSize, shape));
+            executors_[block]->execute([this, begin, end](){
+                if(!failed_.load(std::memory_order_relaxed)) {
+                    try {
+                        for(int i = begin; i < end; ++i) {
+                            std::invoke(body_, std::as_const(*value_), i, *shared_);
+                        }
+                    } catch(...) {
+                        if(!failed_.exchange(true, std::memory_order_relaxed)) {
+                            error_ = std::current_exception();
+                        }
+                    }
+                }
+                if(remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    if(error_) {
+                        fail(std::move(error_));
+                    } else {
+                        finish();
+                    }
+                }
+            });
+            begin = end;
+        }
+    }
+
+    void fail(std::exception_ptr error) override {
+        this->set_exception(std::move(error));
+        this->release();
+    }
+
+    void discard() override {
+        this->release();
+    }
+
+    void finish() {
+        try {
+            if constexpr(std::is_void_v<R>) {
+                std::invoke(selectorF_, std::move(*shared_));
+                this->set_value(Unit{});
+            } else {
+                this->set_value(std::invoke(selectorF_, std::move(*shared_)));
+            }
+        } catch(...) {
+            this->set_exception(std::current_exception());
+        }
+        // Drop the reference held by the previous core
+        this->release();
+    }
+
+    std::vector<std::shared_ptr<DrivenExecutor>> executors_;
+    Body body_;
+    ShapeF shapeF_;
+    SharedF sharedF_;
+    SelectorF selectorF_;
+    std::optional<lift_unit_t<T>> value_;
+    std::optional<SharedT> shared_;
+    std::atomic<int> remaining_{0};
+    std::atomic<bool> failed_{false};
+    // Written by the one block that sets failed_ and read after the last block's
+    // acq_rel decrement of remaining_
+    std::exception_ptr error_;
 };
 
 template<class T>
 class ContinuableFuture {
 public:
+    using ValueT = T;
+    using StorageT = lift_unit_t<T>;
+
     T get() {
         if(core_) {
-            return core_->get();
+            if constexpr(std::is_void_v<T>) {
+                core_->get();
+                return;
+            } else {
+                return core_->get();
+            }
         }
         throw std::logic_error("Incomplete future");
     }
 
-    // TODO: Generalise type
-    ContinuableFuture<T> then(std::function<T(T)> callback) {
-        // This is the simple future/promise pair for a continuable core
-        Promise<T> prom;
-        auto f = prom.get_future().via(core_->getExecutor());
-        core_->setCallback([p = std::move(prom), cb = std::move(callback)](T val) mutable {
-                auto v = cb(std::move(val));
-                p.set_value(std::move(v));
-            });
-        return f;
-    }
-
-    // TODO: Generalise type
-    template<class F>
-    ContinuableFuture<T> thenAwait(F&& callback) {
-        if(core_->isAwaitable()) {
-            // TODO: Actual awaitable used here could differ based on executor pair
-            // or a single ThenAwaitable could handle that (ie do callback directly if
-            // on same executor).
-            // TODO: AsyncAwaitable is fixed to int
-            using AA = MyLibrary::AsyncAwaitable; 
-            auto coroutine = [core = this->core_, cb = std::forward<F>(callback)]() -> AA {
-                auto& aw = core->getAwaitable();
-                auto v = co_await aw; 
-                co_return cb(v);
-            };
-            return make_awaitable_future<T>(coroutine);
+    void wait() {
+        wait_until(FutexClock::time_point::max());
+    }
+
+    template<class Rep, class Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period>& duration) {
+        return wait_until(FutexClock::now() + duration);
+    }
+
+    template<class Clock, class Duration>
+    std::future_status wait_until(const std::chrono::time_point<Clock, Duration>& timePoint) {
+        if(!core_) {
+            throw std::logic_error("Incomplete future");
+        }
+        bool ready;
+        if(timePoint == std::chrono::time_point<Clock, Duration>::max()) {
+            ready = core_->waitUntil(nullptr);
         } else {
-            return then(std::forward<F>(callback));
+            auto deadline = FutexClock::now() +
+                std::chrono::duration_cast<FutexClock::duration>(timePoint - Clock::now());
+            ready = core_->waitUntil(&deadline);
         }
+        return ready ? std::future_status::ready : std::future_status::timeout;
+    }
+
+    // Run later continuations on exec. Only valid before a continuation is attached.
+    ContinuableFuture<T> via(std::shared_ptr<DrivenExecutor> exec) {
+        core_->setExecutor(std::move(exec));
+        return ContinuableFuture<T>{core_};
+    }
+
+    std::shared_ptr<DrivenExecutor> getExecutor() {
+        return core_->getExecutor();
+    }
+
+    // As for Future. The coroutine's executor replaces this future's, if it has one.
+    FutureAwaiter<T> operator co_await() && {
+        return {std::nullopt, std::move(core_)};
+    }
+
+    // Result type is that of the callback, called with no argument for a future of void
+    template<class F, class R = then_result_t<std::decay_t<F>&, T>>
+    ContinuableFuture<R> then(F&& callback) {
+        auto next = new ThenCore<T, R, std::decay_t<F>>(std::forward<F>(callback));
+        CorePtr<CoreBase<lift_unit_t<R>>> nextCore{next};
+        next->setExecutor(core_->getExecutor());
+        attach(next);
+        return ContinuableFuture<R>{std::move(nextCore)};
+    }
+
+    // As then, but run callback on exec. If the value is delivered on exec the callback
+    // runs in that task; otherwise delivery makes a single transfer to exec. A future
+    // backed by an awaitable awaits it directly rather than through a library executor.
+    // A future backed by a promise delivers to exec by adopting it, so getExecutor on
+    // this future returns exec afterwards.
+    template<class F, class R = then_result_t<std::decay_t<F>&, T>>
+    ContinuableFuture<R> thenAwait(std::shared_ptr<DrivenExecutor> exec, F&& callback) {
+        if(!exec) {
+            throw std::logic_error("thenAwait needs an executor, from via or as an argument");
+        }
+        auto next = new ThenCore<T, R, std::decay_t<F>>(std::forward<F>(callback));
+        CorePtr<CoreBase<lift_unit_t<R>>> nextCore{next};
+        next->setExecutor(exec);
+        attach(next, std::move(exec));
+        return ContinuableFuture<R>{std::move(nextCore)};
+    }
+
+    template<class F, class R = then_result_t<std::decay_t<F>&, T>>
+    ContinuableFuture<R> thenAwait(F&& callback) {
+        return thenAwait(core_->getExecutor(), std::forward<F>(callback));
+    }
+
+    // Bulk continuation with the protocol of bulk_then_value. For a value v, shapeF(v)
+    // gives the number of indices and sharedF(shape, v) the shared state. Then
+    // body(v, i, shared) runs for each index, one block of indices per executor in
+    // executors, concurrently if they run on different threads. The result is
+    // selectorF(shared), run after every index on whichever of executors finishes
+    // the last block. Continuations of the returned future run on this future's
+    // executor. An exception from any callback fails the returned future.
+    // A void future's value is Unit.
+    template<class Body, class ShapeF, class SharedF, class SelectorF,
+             class R = std::invoke_result_t<std::decay_t<SelectorF>&,
+                 std::invoke_result_t<std::decay_t<SharedF>&, int, const StorageT&>&&>>
+    ContinuableFuture<R> bulk_then(
+            std::vector<std::shared_ptr<DrivenExecutor>> executors,
+            Body&& body, ShapeF&& shapeF, SharedF&& sharedF, SelectorF&& selectorF) {
+        if(executors.empty() || std::find(executors.begin(), executors.end(), nullptr) != executors.end()) {
+            throw std::logic_error("bulk_then needs executors to run on");
+        }
+        auto next = new BulkCore<T, R, std::decay_t<Body>, std::decay_t<ShapeF>, std::decay_t<SharedF>, std::decay_t<SelectorF>>(
+            std::move(executors),
+            std::forward<Body>(body),
+            std::forward<ShapeF>(shapeF),
+            std::forward<SharedF>(sharedF),
+            std::forward<SelectorF>(selectorF));
+        CorePtr<CoreBase<lift_unit_t<R>>> nextCore{next};
+        next->setExecutor(core_->getExecutor());
+        attach(next);
+        return ContinuableFuture<R>{std::move(nextCore)};
+    }
+
+    // As above with every index run on this future's executor
+    template<class Body, class ShapeF, class SharedF, class SelectorF>
+    auto bulk_then(Body&& body, ShapeF&& shapeF, SharedF&& sharedF, SelectorF&& selectorF) {
+        return bulk_then(
+            {core_->getExecutor()},
+            std::forward<Body>(body),
+            std::forward<ShapeF>(shapeF),
+            std::forward<SharedF>(sharedF),
+            std::forward<SelectorF>(selectorF));
     }
 
 private:
-    ContinuableFuture(std::shared_ptr<CoreBase<T>> core) : core_{std::move(core)} { 
+    ContinuableFuture(CorePtr<CoreBase<StorageT>> core) : core_{std::move(core)} { 
+    }
+
+    // This core holds a reference to next until the callback has run. The reference
+    // is dropped again if the callback cannot be set, as with no executor.
+    template<class Next, class... Target>
+    void attach(Next* next, Target&&... target) {
+        next->acquire();
+        try {
+            core_->setCallback(next, std::forward<Target>(target)...);
+        } catch(...) {
+            next->release();
+            throw;
+        }
     }
 
     friend class Future<T>;
-    std::shared_ptr<CoreBase<T>> core_;
+    friend class SharedFuture<T>;
+    template<class FriendT> friend class ContinuableFuture;
+    template<class FriendT> friend class SharedFuture;
+    template<class FriendT, class Result> friend struct JoinCore;
+    CorePtr<CoreBase<StorageT>> core_;
 };
 
 template<class T>
@@ -271,12 +993,16 @@ ContinuableFuture<T> Future<T>::via(std::shared_ptr<DrivenExecutor> exec) {
 
 template<class T>
 Future<T> make_future(T value) {
-    return Future(std::move(value));
+    return Future<T>(std::move(value));
+}
+
+inline Future<void> make_future() {
+    return Future<void>(Unit{});
 }
 
 template<class T, class AwaitableT>
 Future<T> make_awaitable_future(AwaitableT awaitable) {
-    auto core = std::make_shared<AwaitableCore<T, AwaitableT>>(std::move(awaitable));
+    CorePtr<CoreBase<T>> core{new AwaitableCore<T, AwaitableT>(std::move(awaitable))};
     return Future<T>(std::move(core));
 }
 
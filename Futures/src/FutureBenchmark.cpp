@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "Executor.h"
+#include "Collect.h"
+#include "Deferred.h"
+#include "Future.h"
+#include "PromiseBatch.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Count every heap allocation made by the process.
+// g++ takes the replaced delete freeing memory from the replaced new as a mismatch.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if(void* p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+struct Result {
+    double nsPerThen = 0;
+    double allocationsPerThen = 0;
+};
+
+// Build a chain of length then calls on a promise-backed future, fulfil the promise
+// and drive the executor on this thread until the last continuation has run.
+template<class Step>
+Result thenChainOnce(int length, Step& step) {
+    auto exec = std::make_shared<DrivenExecutor>();
+
+    auto startAllocations = allocations.load();
+    auto start = Clock::now();
+    Promise<int> p;
+    auto cf = p.get_future().via(exec);
+    for(int i = 0; i < length; ++i) {
+        cf = step(std::move(cf));
+    }
+    int result = 0;
+    auto last = cf.then([&](int v){ result = v; exec->terminate(); });
+    p.set_value(1);
+    exec->run();
+    auto end = Clock::now();
+    auto endAllocations = allocations.load();
+
+    if(result != length + 1) {
+        std::cout << "Unexpected result " << result << "\n";
+    }
+    return {
+        std::chrono::duration<double, std::nano>(end - start).count() / length,
+        double(endAllocations - startAllocations) / length};
+}
+
+template<class Step>
+Result thenChain(int length, Step step) {
+    // Repeat short chains so that each length runs a similar number of steps
+    constexpr int totalSteps = 100000;
+    int repetitions = std::max(1, totalSteps / length);
+    Result total;
+    for(int i = 0; i < repetitions; ++i) {
+        auto r = thenChainOnce(length, step);
+        total.nsPerThen += r.nsPerThen / repetitions;
+        total.allocationsPerThen += r.allocationsPerThen / repetitions;
+    }
+    return total;
+}
+
+std::ostream& operator<<(std::ostream& os, const Result& r) {
+    return os << r.nsPerThen << " ns/then (" << r.allocationsPerThen << " allocations/then)";
+}
+
+// Repeatedly wait on a future whose value is already set. Each wait is one call into
+// the core so this measures the cost of dispatching to it.
+double readyWait(int calls) {
+    Promise<int> p;
+    auto f = p.get_future();
+    p.set_value(1);
+    auto start = Clock::now();
+    for(int i = 0; i < calls; ++i) {
+        f.wait();
+    }
+    auto end = Clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / calls;
+}
+
+// Run chains of five stages on one executor, attached either eagerly with then,
+// which costs a task per stage, or through defer, which fuses them into one task.
+template<class Attach>
+Result fiveStageChains(int chains, Attach attach) {
+    auto exec = std::make_shared<DrivenExecutor>();
+    std::vector<Promise<int>> promises(chains);
+    std::vector<ContinuableFuture<int>> results;
+    results.reserve(chains);
+
+    auto startAllocations = allocations.load();
+    auto start = Clock::now();
+    for(auto& p : promises) {
+        results.push_back(attach(p.get_future().via(exec)));
+    }
+    int remaining = chains;
+    for(auto& r : results) {
+        r.then([&](int){
+                if(--remaining == 0) {
+                    exec->terminate();
+                }
+            });
+    }
+    for(auto& p : promises) {
+        p.set_value(1);
+    }
+    exec->run();
+    auto end = Clock::now();
+    auto endAllocations = allocations.load();
+
+    return {
+        std::chrono::duration<double, std::nano>(end - start).count() / chains,
+        double(endAllocations - startAllocations) / chains};
+}
+
+// Scatter to shards promises, gather them with collectAll and report the allocations
+// made by the join itself, excluding those of the promises.
+void scatterGather(int shards) {
+    auto exec = std::make_shared<DrivenExecutor>();
+    std::vector<Promise<int>> promises(shards);
+    std::vector<ContinuableFuture<int>> futures;
+    futures.reserve(shards);
+    for(auto& p : promises) {
+        futures.push_back(p.get_future().via(exec));
+    }
+
+    auto startAllocations = allocations.load();
+    auto start = Clock::now();
+    auto sum = collectAll(std::move(futures)).then([&](std::vector<int> values){
+            exec->terminate();
+            return std::accumulate(values.begin(), values.end(), 0L);
+        });
+    for(int i = 0; i < shards; ++i) {
+        promises[i].set_value(i);
+    }
+    exec->run();
+    auto result = sum.get();
+    auto end = Clock::now();
+    auto endAllocations = allocations.load();
+
+    std::cout << "collectAll over " << shards << " shards: "
+              << std::chrono::duration<double, std::nano>(end - start).count() / shards << " ns/shard, "
+              << endAllocations - startAllocations << " allocations (sum " << result << ")\n";
+}
+
+// Fulfil promises whose continuations are spread over executors, each run by its own
+// thread, either one at a time or through a PromiseBatch. Reports the time per promise
+// until every continuation has run.
+template<class Fulfil>
+double fulfilment(int promiseCount, int executorCount, Fulfil fulfil) {
+    std::vector<std::shared_ptr<DrivenExecutor>> execs;
+    std::vector<std::thread> threads;
+    for(int i = 0; i < executorCount; ++i) {
+        execs.push_back(std::make_shared<DrivenExecutor>());
+        threads.emplace_back([exec = execs.back()](){ exec->run(); });
+    }
+    std::vector<Promise<int>> promises(promiseCount);
+    std::atomic<int> remaining{promiseCount};
+    Promise<void> allDone;
+    auto done = allDone.get_future();
+    std::vector<ContinuableFuture<void>> results;
+    results.reserve(promiseCount);
+    for(int i = 0; i < promiseCount; ++i) {
+        results.push_back(promises[i].get_future().via(execs[i % executorCount]).then([&](int){
+                if(--remaining == 0) {
+                    allDone.set_value();
+                }
+            }));
+    }
+
+    auto start = Clock::now();
+    fulfil(promises);
+    done.get();
+    auto end = Clock::now();
+
+    for(int i = 0; i < executorCount; ++i) {
+        execs[i]->terminate();
+        threads[i].join();
+    }
+    return std::chrono::duration<double, std::nano>(end - start).count() / promiseCount;
+}
+
+// Block in get on this thread while another thread sets the value after delay,
+// returning the mean time from set_value to get returning.
+double wakeLatency(std::chrono::microseconds delay, int repetitions) {
+    double total = 0;
+    for(int i = 0; i < repetitions; ++i) {
+        Promise<int> p;
+        auto f = p.get_future();
+        std::atomic<Clock::rep> setTime{0};
+        auto t = std::thread([&](){
+                std::this_thread::sleep_for(delay);
+                setTime = Clock::now().time_since_epoch().count();
+                p.set_value(1);
+            });
+        f.get();
+        auto wakeTime = Clock::now().time_since_epoch().count();
+        t.join();
+        total += std::chrono::duration<double, std::micro>(
+            Clock::duration{wakeTime - setTime.load()}).count();
+    }
+    return total / repetitions;
+}
+
+double cpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// Fraction of a core used by the process while waiting for a value that is set
+// by a sleeping thread after delay.
+template<class Wait>
+double waitingCpu(std::chrono::milliseconds delay, Wait wait) {
+    Promise<int> p;
+    auto f = p.get_future();
+    std::atomic<bool> set{false};
+    auto startCpu = cpuSeconds();
+    auto start = Clock::now();
+    auto t = std::thread([&](){
+            std::this_thread::sleep_for(delay);
+            p.set_value(1);
+            set = true;
+        });
+    wait(f, set);
+    t.join();
+    auto wall = std::chrono::duration<double>(Clock::now() - start).count();
+    return (cpuSeconds() - startCpu) / wall;
+}
+
+int main() {
+    {
+        auto startAllocations = allocations.load();
+        auto f = make_future(3);
+        f.get();
+        std::cout << "Ready future: " << allocations.load() - startAllocations << " allocations\n";
+    }
+
+    std::cout << "Wait on a ready promise-backed future: " << readyWait(100000000) << " ns/call\n";
+
+    for(int length : {10, 100, 1000, 10000, 100000}) {
+        auto small = thenChain(length, [](ContinuableFuture<int> cf){
+                return cf.then([](int v){ return v + 1; });
+            });
+        auto largeCapture = thenChain(length, [](ContinuableFuture<int> cf){
+                std::array<int, 16> capture{1};
+                return cf.then([capture](int v){ return v + capture[0]; });
+            });
+        auto moveOnly = thenChain(length, [](ContinuableFuture<int> cf){
+                return cf
+                    .then([](int v){ return std::make_unique<int>(v + 1); })
+                    .then([](std::unique_ptr<int> v){ return *v; });
+            });
+        moveOnly.nsPerThen /= 2;
+        moveOnly.allocationsPerThen /= 2;
+        std::cout << "Chain length " << length << ":\n"
+                  << "  small capture " << small << "\n"
+                  << "  large capture " << largeCapture << "\n"
+                  << "  via unique_ptr " << moveOnly << "\n";
+    }
+
+    {
+        constexpr int chains = 100000;
+        auto add = [](int v){ return v + 1; };
+        auto eager = fiveStageChains(chains, [&](ContinuableFuture<int> cf){
+                return cf.then(add).then(add).then(add).then(add).then(add);
+            });
+        auto fused = fiveStageChains(chains, [&](ContinuableFuture<int> cf){
+                return defer(std::move(cf)).then(add).then(add).then(add).then(add).then(add).future();
+            });
+        std::cout << "Five stage chain, eager then: " << eager.nsPerThen << " ns/chain ("
+                  << eager.allocationsPerThen << " allocations/chain)\n"
+                  << "Five stage chain, deferred: " << fused.nsPerThen << " ns/chain ("
+                  << fused.allocationsPerThen << " allocations/chain)\n";
+    }
+
+    for(int promiseCount : {100, 1000, 100000}) {
+        auto single = fulfilment(promiseCount, 4, [](std::vector<Promise<int>>& promises){
+                for(auto& p : promises) {
+                    p.set_value(1);
+                }
+            });
+        auto batched = fulfilment(promiseCount, 4, [](std::vector<Promise<int>>& promises){
+                PromiseBatch batch;
+                for(auto& p : promises) {
+                    batch.set_value(p, 1);
+                }
+            });
+        std::cout << "Fulfilling " << promiseCount << " promises over 4 executors: one at a time "
+                  << single << " ns/promise, batched " << batched << " ns/promise\n";
+    }
+
+    for(int shards : {100, 10000, 1000000}) {
+        scatterGather(shards);
+    }
+
+    for(auto delay : {std::chrono::microseconds{0}, std::chrono::microseconds{100}, std::chrono::microseconds{1000}}) {
+        std::cout << "Wake-up latency after " << delay.count() << "us: "
+                  << wakeLatency(delay, 200) << " us\n";
+    }
+
+    auto blockingCpu = waitingCpu(std::chrono::milliseconds{200}, [](Future<int>& f, std::atomic<bool>&){
+            f.get();
+        });
+    auto spinningCpu = waitingCpu(std::chrono::milliseconds{200}, [](Future<int>& f, std::atomic<bool>& set){
+            while(!set) {}
+            f.get();
+        });
+    std::cout << "CPU used while waiting 200ms: blocking get " << blockingCpu * 100
+              << "% of a core, busy-spin " << spinningCpu * 100 << "% of a core\n";
+
+    return 0;
+}
@@ -1,5 +1,14 @@
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <vector>
 #include <experimental/coroutine>
 
 #include "Executor.h"
@@ -19,6 +28,38 @@ MyLibrary::AsyncAwaitable asyncEntryPoint(int value) {
     co_return v + v2;
 }
 
+// Large payload that counts how often it is copied
+struct Payload {
+    explicit Payload(std::size_t size) : data(size) {}
+    Payload(const Payload& rhs) : data{rhs.data} {
+        ++copies;
+    }
+    Payload(Payload&&) = default;
+    Payload& operator=(const Payload& rhs) {
+        data = rhs.data;
+        ++copies;
+        return *this;
+    }
+    Payload& operator=(Payload&&) = default;
+
+    std::vector<char> data;
+    static inline std::atomic<int> copies{0};
+};
+
+MyLibrary::AsyncAwaitable awaitPayload(ContinuableFuture<Payload> cf) {
+    auto payload = co_await std::move(cf);
+    co_return static_cast<int>(payload.data.size());
+}
+
+// Await futures directly, resuming on this coroutine's executor
+MyLibrary::AsyncAwaitable awaitFutures(Future<int> f, ContinuableFuture<std::string> cf, Future<int> ready) {
+    auto v = co_await std::move(f);
+    where("After co_await on a future");
+    auto s = co_await std::move(cf);
+    where("After co_await on a continuable future");
+    co_return v + static_cast<int>(s.size()) + co_await std::move(ready);
+}
+
 int main() {
     // Temporarily create this globally
     where("main()");
@@ -64,10 +105,138 @@ int main() {
                 exec->run();
             });
         p.set_value(7);
-        while(val == 0) {}
+        auto result = cf.get();
+        exec->terminate();
+        t.join();
+        std::cout << "Val: " << val << " and returned " << result << "\n";
+    }
+
+    {
+        where("Via and then changing type, returning void and move-only");
+        Promise<int> p;
+        auto f = p.get_future();
+        auto exec = std::make_shared<DrivenExecutor>(); 
+        std::atomic<int> val = 0;
+        int doubled = 0;
+        auto cf = f.via(exec)
+            .then([](int v){ return std::to_string(v); })
+            .then([](std::string s){ return std::make_unique<int>(std::stoi(s) * 2); })
+            .then([&](std::unique_ptr<int> v){ doubled = *v; })
+            .then([&](){ val = doubled; });
+        auto t = std::thread([&](){
+                exec->run();
+            });
+        p.set_value(7);
+        cf.get();
+        exec->terminate();
+        t.join();
+        std::cout << "Val: " << val << "\n";
+    }
+
+    {
+        where("Timed waits");
+        Promise<int> p;
+        auto f = p.get_future();
+        auto timedOut = f.wait_for(std::chrono::milliseconds(10)) == std::future_status::timeout;
+        auto t = std::thread([&](){
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                p.set_value(9);
+            });
+        auto ready = f.wait_until(std::chrono::steady_clock::now() + std::chrono::seconds(10)) ==
+            std::future_status::ready;
+        t.join();
+        std::cout << "Timed out before set: " << timedOut << ", ready after set: " << ready
+                  << ", value: " << f.get() << "\n";
+    }
+
+    {
+        where("Broken promises and throwing callbacks");
+        auto exec = std::make_shared<DrivenExecutor>();
+        auto t = std::thread([&](){
+                exec->run();
+            });
+        auto isBroken = [](auto& future) {
+            try {
+                future.get();
+            } catch(const std::future_error& e) {
+                return e.code() == std::future_errc::broken_promise;
+            }
+            return false;
+        };
+        std::optional<Promise<int>> waited{std::in_place};
+        auto f = waited->get_future();
+        auto breaker = std::thread([&](){
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                waited.reset();
+            });
+        auto waiterWoken = isBroken(f);
+        breaker.join();
+        std::optional<Promise<int>> chained{std::in_place};
+        bool ranThen = false;
+        auto cf = chained->get_future().via(exec).then([&](int v){ ranThen = true; return v; });
+        chained.reset();
+        Promise<int> p;
+        auto throwing = p.get_future().via(exec)
+            .then([](int v) -> int { throw std::runtime_error(std::to_string(v)); })
+            .then([](int v){ return v + 1; });
+        p.set_value(3);
+        std::string message;
+        try {
+            throwing.get();
+        } catch(const std::runtime_error& e) {
+            message = e.what();
+        }
+        std::cout << "Waiter woken by a broken promise: " << waiterWoken
+                  << ", continuation skipped and broken: " << (isBroken(cf) && !ranThen)
+                  << ", callback exception passed on: " << message << "\n";
+        exec->terminate();
+        t.join();
+    }
+
+    {
+        where("co_await on futures");
+        auto exec = std::make_shared<DrivenExecutor>();
+        Promise<int> p1;
+        Promise<std::string> p2;
+        auto cf = p2.get_future().via(exec).then([](std::string s){ return s + "!"; });
+        auto t = std::thread([&](){
+                exec->run();
+            });
+        auto setter = std::thread([&](){
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                p1.set_value(10);
+                p2.set_value("abc");
+            });
+        auto result = sync_await(awaitFutures(p1.get_future(), std::move(cf), make_future(100)));
+        setter.join();
         exec->terminate();
         t.join();
-        std::cout << "Val: " << val << " and returned " << cf.get() << "\n";
+        std::cout << "Awaited: " << result << "\n";
+    }
+
+    {
+        where("Large payloads are moved, never copied");
+        constexpr std::size_t size = 8 << 20;
+        auto exec = std::make_shared<DrivenExecutor>();
+        Promise<Payload> p1;
+        Promise<Payload> p2;
+        auto cf = p1.get_future().via(exec)
+            .then([](Payload payload){ payload.data[0] = 1; return payload; })
+            .then([](Payload payload){ return std::make_unique<Payload>(std::move(payload)); })
+            .thenAwait([](std::unique_ptr<Payload> payload){ return std::move(*payload); });
+        auto awaited = p2.get_future().via(exec);
+        auto t = std::thread([&](){
+                exec->run();
+            });
+        p1.set_value(Payload{size});
+        p2.set_value(Payload{size});
+        auto result = cf.get();
+        auto awaitedSize = sync_await(awaitPayload(std::move(awaited)));
+        auto ready = make_future(Payload{size}).get();
+        exec->terminate();
+        t.join();
+        std::cout << "Payload sizes: " << result.data.size() << ", " << awaitedSize << ", " << ready.data.size()
+                  << ", copies: " << Payload::copies << "\n";
     }
 
     {
@@ -79,10 +248,10 @@ int main() {
         auto t = std::thread([&](){
                 exec->run();
             });
-        while(val == 0) {}
+        auto result = cf.get();
         exec->terminate();
         t.join();
-        std::cout << "Val: " << val << " and returned " << cf.get() << "\n";
+        std::cout << "Val: " << val << " and returned " << result << "\n";
     }
     
     {
@@ -94,13 +263,205 @@ int main() {
         auto t = std::thread([&](){
                 exec->run();
             });
-        while(val == 0) {}
+        auto result = cf.get();
         exec->terminate();
         t.join();
-        std::cout << "Val: " << val << " and returned " << cf.get() << "\n";
+        std::cout << "Val: " << val << " and returned " << result << "\n";
  
     }
 
+    {
+        where("thenAwait onto another executor, changing type");
+        auto exec1 = std::make_shared<DrivenExecutor>();
+        auto exec2 = std::make_shared<DrivenExecutor>();
+        std::atomic<DrivenExecutor*> ranOn1{nullptr};
+        std::atomic<DrivenExecutor*> ranOn2{nullptr};
+        auto fromAwaitable = make_awaitable_future<int>(adder(4)).via(exec1)
+            .thenAwait(exec2, [&](int v){ ranOn1 = DrivenExecutor::current(); return std::to_string(v); });
+        Promise<std::string> p;
+        auto fromPromise = p.get_future().via(exec1)
+            .thenAwait(exec2, [&](std::string s){ ranOn2 = DrivenExecutor::current(); return s.size(); });
+        auto t1 = std::thread([&](){
+                exec1->run();
+            });
+        auto t2 = std::thread([&](){
+                exec2->run();
+            });
+        p.set_value("four");
+        auto s = fromAwaitable.get();
+        auto size = fromPromise.get();
+        exec1->terminate();
+        exec2->terminate();
+        t1.join();
+        t2.join();
+        std::cout << "From awaitable: " << s << ", from promise: " << size
+                  << ", both ran on the target: " << (ranOn1 == exec2.get() && ranOn2 == exec2.get()) << "\n";
+    }
+
+    {
+        where("thenAwait without an executor");
+        auto rejected = [](auto&& future) {
+            try {
+                future.thenAwait([](int v){ return v; });
+            } catch(const std::logic_error&) {
+                return true;
+            }
+            return false;
+        };
+        Promise<int> p;
+        auto fromAwaitable = rejected(make_awaitable_future<int>(adder(1)).via(nullptr));
+        auto fromPromise = rejected(p.get_future().via(nullptr));
+        std::cout << "Rejected for an awaitable: " << fromAwaitable << ", for a promise: " << fromPromise << "\n";
+    }
+
+    {
+        where("then and bulk_then without an executor");
+        Promise<int> p1;
+        Promise<int> p2;
+        bool thenRejected = false;
+        bool bulkRejected = false;
+        try {
+            p1.get_future().via(nullptr).then([](int v){ return v; });
+        } catch(const std::logic_error&) {
+            thenRejected = true;
+        }
+        try {
+            p2.get_future().via(nullptr).bulk_then(
+                {std::make_shared<DrivenExecutor>()},
+                [](int, int, int&){},
+                [](int){ return 1; },
+                [](int, int){ return 0; },
+                [](int&& shared){ return shared; });
+        } catch(const std::logic_error&) {
+            bulkRejected = true;
+        }
+        std::cout << "Rejected for then: " << thenRejected << ", for bulk_then: " << bulkRejected << "\n";
+    }
+
+    {
+        where("bulk_then across a pool of executors");
+        auto exec1 = std::make_shared<DrivenExecutor>();
+        auto exec2 = std::make_shared<DrivenExecutor>();
+        Promise<int> p;
+        std::atomic<DrivenExecutor*> selectedOn{nullptr};
+        std::atomic<DrivenExecutor*> nextOn{nullptr};
+        // Each index writes its own element, so the shared state needs no lock
+        auto cf = p.get_future().via(exec1)
+            .bulk_then(
+                {exec1, exec2},
+                [](int input, int i, std::vector<DrivenExecutor*>& ranOn){
+                    ranOn[i] = DrivenExecutor::current();
+                    (void)input;
+                },
+                [](int input){ return input; },
+                [](int shape, int /*input*/){ return std::vector<DrivenExecutor*>(shape); },
+                [&](std::vector<DrivenExecutor*>&& ranOn){
+                    selectedOn = DrivenExecutor::current();
+                    return std::count(ranOn.begin(), ranOn.end(), exec1.get()) * 10 +
+                        std::count(ranOn.begin(), ranOn.end(), exec2.get());
+                })
+            .then([&](long counts){ nextOn = DrivenExecutor::current(); return counts; });
+        Promise<void> empty;
+        auto emptyCf = empty.get_future().via(exec1)
+            .bulk_then(
+                [](Unit, int, int&){},
+                [](Unit){ return 0; },
+                [](int, Unit){ return 5; },
+                [](int&& shared){ return shared; });
+        auto t1 = std::thread([&](){
+                exec1->run();
+            });
+        auto t2 = std::thread([&](){
+                exec2->run();
+            });
+        p.set_value(6);
+        empty.set_value();
+        auto counts = cf.get();
+        auto emptyResult = emptyCf.get();
+        exec1->terminate();
+        exec2->terminate();
+        t1.join();
+        t2.join();
+        std::cout << "Indices run on exec1 and exec2: " << counts / 10 << " and " << counts % 10
+                  << ", selector on a pool executor: " << (selectedOn == exec1.get() || selectedOn == exec2.get())
+                  << ", next on exec1: " << (nextOn == exec1.get())
+                  << ", empty shape: " << emptyResult << "\n";
+    }
+
+    {
+        where("bulk_then with a throwing body");
+        auto exec1 = std::make_shared<DrivenExecutor>();
+        auto exec2 = std::make_shared<DrivenExecutor>();
+        Promise<int> p;
+        auto cf = p.get_future().via(exec1)
+            .bulk_then(
+                {exec1, exec2},
+                [](int /*input*/, int i, int& /*shared*/){
+                    if(i == 7) {
+                        throw std::runtime_error("index 7");
+                    }
+                },
+                [](int input){ return input; },
+                [](int /*shape*/, int /*input*/){ return 0; },
+                [](int&& shared){ return shared; });
+        auto t1 = std::thread([&](){
+                exec1->run();
+            });
+        auto t2 = std::thread([&](){
+                exec2->run();
+            });
+        p.set_value(10);
+        std::string message;
+        try {
+            cf.get();
+        } catch(const std::runtime_error& e) {
+            message = e.what();
+        }
+        exec1->terminate();
+        exec2->terminate();
+        t1.join();
+        t2.join();
+        std::cout << "Exception from a bulk block fails the future: " << message << "\n";
+    }
+
+    {
+        where("bulk_then over INT_MAX indices");
+        // Each block throws at its first index, so only the split itself is exercised
+        std::vector<std::shared_ptr<DrivenExecutor>> execs;
+        std::vector<std::thread> threads;
+        for(int e = 0; e < 3; ++e) {
+            execs.push_back(std::make_shared<DrivenExecutor>());
+            threads.emplace_back([exec = execs.back()](){
+                    exec->run();
+                });
+        }
+        Promise<int> p;
+        auto cf = p.get_future().via(execs[0])
+            .bulk_then(
+                execs,
+                [](int /*input*/, int i, int& /*shared*/){
+                    throw std::runtime_error(std::to_string(i));
+                },
+                [](int input){ return input; },
+                [](int /*shape*/, int /*input*/){ return 0; },
+                [](int&& shared){ return shared; });
+        p.set_value(std::numeric_limits<int>::max());
+        std::string message;
+        try {
+            cf.get();
+        } catch(const std::runtime_error& e) {
+            message = e.what();
+        }
+        for(auto& e : execs) {
+            e->terminate();
+        }
+        for(auto& thread : threads) {
+            thread.join();
+        }
+        std::cout << "Failed at the start of a block: "
+                  << (message == "0" || message == "715827883" || message == "1431655766") << "\n";
+    }
+
     MyLibrary::shutdown();
     std::cout << "END\n";
 
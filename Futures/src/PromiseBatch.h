@@ -0,0 +1,68 @@
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Executor.h"
+#include "Future.h"
+
+// Fulfils many promises together. Continuations made ready by set_value are held back
+// and grouped by executor, and flush submits each group with one executeBatch, so
+// resolving N promises costs one queue lock and notify per executor rather than per
+// promise. Getters blocked on a promise are still woken by its set_value.
+class PromiseBatch {
+public:
+    PromiseBatch() = default;
+    PromiseBatch(const PromiseBatch&) = delete;
+    PromiseBatch& operator=(const PromiseBatch&) = delete;
+
+    ~PromiseBatch() {
+        flush();
+    }
+
+    template<class T>
+    void set_value(Promise<T>& promise, typename Promise<T>::StorageT&& value) {
+        auto core = promise.core_.get();
+        if(core->publish(std::move(value))) {
+            add(core->exec_, core->makeTask());
+        }
+    }
+
+    template<class T, std::enable_if_t<std::is_void_v<T>, int> = 0>
+    void set_value(Promise<T>& promise) {
+        set_value(promise, Unit{});
+    }
+
+    // Fulfil each promise in [first, last) with the matching element of values, which is moved from
+    template<class PromiseIt, class ValueIt>
+    void set_values(PromiseIt first, PromiseIt last, ValueIt values) {
+        for(; first != last; ++first, ++values) {
+            set_value(*first, std::move(*values));
+        }
+    }
+
+    // Submit the continuations gathered so far
+    void flush() {
+        for(auto& batch : batches_) {
+            batch.first->executeBatch(std::move(batch.second));
+        }
+        batches_.clear();
+    }
+
+private:
+    void add(const std::shared_ptr<DrivenExecutor>& exec, std::function<void()> task) {
+        auto batch = batches_.begin();
+        while(batch != batches_.end() && batch->first != exec) {
+            ++batch;
+        }
+        if(batch == batches_.end()) {
+            batch = batches_.emplace(batches_.end(), exec, std::vector<std::function<void()>>{});
+        }
+        batch->second.push_back(std::move(task));
+    }
+
+    std::vector<std::pair<std::shared_ptr<DrivenExecutor>, std::vector<std::function<void()>>>> batches_;
+};
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "Executor.h"
+#include "MyAsyncLibrary.h"
+#include "PromiseBatch.h"
+
+int main() {
+    where("main()");
+
+    {
+        where("Batch of promises with continuations on two executors");
+        auto exec1 = std::make_shared<DrivenExecutor>();
+        auto exec2 = std::make_shared<DrivenExecutor>();
+        constexpr int count = 300;
+        std::vector<Promise<int>> promises(count);
+        std::vector<ContinuableFuture<int>> results;
+        for(int i = 0; i < count; ++i) {
+            results.push_back(promises[i].get_future().via(i % 2 ? exec1 : exec2).then([](int v){ return v * 2; }));
+        }
+        // A promise without a continuation is only published
+        Promise<int> plain;
+        auto plainFuture = plain.get_future();
+
+        std::vector<int> values(count);
+        std::iota(values.begin(), values.end(), 0);
+        {
+            PromiseBatch batch;
+            batch.set_values(promises.begin(), promises.end(), values.begin());
+            batch.set_value(plain, 7);
+        }
+        auto t1 = std::thread([&](){
+                exec1->run();
+            });
+        auto t2 = std::thread([&](){
+                exec2->run();
+            });
+        int total = 0;
+        for(auto& r : results) {
+            total += r.get();
+        }
+        exec1->terminate();
+        exec2->terminate();
+        t1.join();
+        t2.join();
+        std::cout << "Total: " << total << ", plain: " << plainFuture.get() << "\n";
+    }
+
+    {
+        where("Batch of void promises, flushed explicitly");
+        auto exec = std::make_shared<DrivenExecutor>();
+        std::vector<Promise<void>> promises(3);
+        std::atomic<int> count = 0;
+        std::vector<ContinuableFuture<void>> results;
+        for(auto& p : promises) {
+            results.push_back(p.get_future().via(exec).then([&](){ ++count; }));
+        }
+        PromiseBatch batch;
+        for(auto& p : promises) {
+            batch.set_value(p);
+        }
+        batch.flush();
+        auto t = std::thread([&](){
+                exec->run();
+            });
+        for(auto& r : results) {
+            r.get();
+        }
+        exec->terminate();
+        t.join();
+        std::cout << "Void continuations: " << count << "\n";
+    }
+
+    std::cout << "END\n";
+
+    return 0;
+}
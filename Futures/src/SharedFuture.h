@@ -0,0 +1,246 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "Executor.h"
+#include "Future.h"
+
+// Consumer of a shared result. Consumers form an intrusive list in the shared core
+// and are run with a const reference to the single stored value.
+template<class T>
+struct SharedContinuation {
+    virtual void run(const T& value) = 0;
+    // Called instead of run when the shared core completes with an exception
+    virtual void fail(std::exception_ptr error) = 0;
+    // Called instead of run when the shared core is destroyed without a value
+    virtual void discard() = 0;
+
+    DrivenExecutor* executor_ = nullptr;
+    SharedContinuation* next_ = nullptr;
+
+protected:
+    ~SharedContinuation() {}
+};
+
+// Core holding one result for any number of consumers. Consumers are pushed onto a
+// lock-free list; when the value arrives the list is swapped for a completed marker
+// and dispatched with one batch per executor.
+template<class T>
+struct SharedCore final : Continuation<T> {
+    ~SharedCore() {
+        auto head = head_.load(std::memory_order_acquire);
+        if(head != completed()) {
+            while(head) {
+                std::exchange(head, head->next_)->discard();
+            }
+        }
+    }
+
+    // Forwarded from the core of the future this was constructed from
+    void run(T&& value) override {
+        set_value(std::move(value));
+        release();
+    }
+
+    void fail(std::exception_ptr error) override {
+        set_exception(std::move(error));
+        release();
+    }
+
+    void discard() override {
+        release();
+    }
+
+    void set_value(T&& value) {
+        value_.emplace(std::move(value));
+        complete();
+    }
+
+    // Every consumer is failed with error
+    void set_exception(std::exception_ptr error) {
+        exception_ = std::move(error);
+        complete();
+    }
+
+    void complete() {
+        auto head = head_.exchange(completed(), std::memory_order_acq_rel);
+
+        // The list is in reverse order of registration
+        SharedContinuation<T>* ordered = nullptr;
+        while(head) {
+            std::exchange(head, head->next_)->next_ = std::exchange(ordered, head);
+        }
+
+        std::vector<std::pair<DrivenExecutor*, std::vector<std::function<void()>>>> batches;
+        for(auto cont = ordered; cont; cont = cont->next_) {
+            auto batch = batches.begin();
+            while(batch != batches.end() && batch->first != cont->executor_) {
+                ++batch;
+            }
+            if(batch == batches.end()) {
+                batch = batches.emplace(batches.end(), cont->executor_, std::vector<std::function<void()>>{});
+            }
+            batch->second.push_back(makeTask(cont));
+        }
+        for(auto& batch : batches) {
+            batch.first->executeBatch(std::move(batch.second));
+        }
+        valueSet_.post();
+    }
+
+    void addContinuation(SharedContinuation<T>* cont) {
+        auto head = head_.load(std::memory_order_acquire);
+        do {
+            if(head == completed()) {
+                cont->executor_->execute(makeTask(cont));
+                return;
+            }
+            cont->next_ = head;
+        } while(!head_.compare_exchange_weak(
+            head, cont, std::memory_order_acq_rel, std::memory_order_acquire));
+    }
+
+    bool ready() const {
+        return head_.load(std::memory_order_acquire) == completed();
+    }
+
+    const T& get() {
+        valueSet_.wait();
+        if(exception_) {
+            std::rethrow_exception(exception_);
+        }
+        return *value_;
+    }
+
+    // As for ValueCore the task carries its reference to the core as a raw pointer
+    std::function<void()> makeTask(SharedContinuation<T>* cont) {
+        acquire();
+        return [core = this, cont](){
+            if(core->exception_) {
+                cont->fail(core->exception_);
+            } else {
+                cont->run(*core->value_);
+            }
+            core->release();
+        };
+    }
+
+    SharedContinuation<T>* completed() const {
+        // The core's own address is never a consumer so it marks the completed list
+        return reinterpret_cast<SharedContinuation<T>*>(const_cast<SharedCore*>(this));
+    }
+
+    void acquire() {
+        refCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() {
+        if(refCount_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    std::atomic<int> refCount_{0};
+    std::optional<T> value_;
+    std::exception_ptr exception_;
+    std::atomic<SharedContinuation<T>*> head_{nullptr};
+    Baton valueSet_;
+};
+
+// Result of calling a continuation on a const reference to a shared T
+template<class F, class T>
+using shared_then_result_t = then_result_t<F,
+    std::conditional_t<std::is_void_v<T>, void, std::add_lvalue_reference_t<std::add_const_t<T>>>>;
+
+// Core of the future returned by SharedFuture::then, which is also the consumer
+// registered with the shared core.
+template<class T, class R, class F>
+struct SharedThenCore : ValueCore<lift_unit_t<R>>, SharedContinuation<lift_unit_t<T>> {
+    template<class CallbackT>
+    SharedThenCore(CallbackT&& callback) : func_{std::forward<CallbackT>(callback)} {}
+
+    void run(const lift_unit_t<T>& value) override {
+        try {
+            if constexpr(std::is_void_v<R>) {
+                invoke(value);
+                this->set_value(Unit{});
+            } else {
+                this->set_value(invoke(value));
+            }
+        } catch(...) {
+            this->set_exception(std::current_exception());
+        }
+        this->release();
+    }
+
+    void fail(std::exception_ptr error) override {
+        this->set_exception(std::move(error));
+        this->release();
+    }
+
+    void discard() override {
+        this->release();
+    }
+
+    decltype(auto) invoke(const lift_unit_t<T>& value) {
+        if constexpr(std::is_void_v<T>) {
+            return std::invoke(func_);
+        } else {
+            return std::invoke(func_, value);
+        }
+    }
+
+    F func_;
+};
+
+// Future whose value may be consumed by many continuations. Consumers see a const
+// reference to the one stored value, so it is never copied per consumer.
+template<class T>
+class SharedFuture {
+public:
+    using StorageT = lift_unit_t<T>;
+
+    // Consume a continuable future. Its value is forwarded to the shared core on its executor.
+    SharedFuture(ContinuableFuture<T>&& future) : core_{new SharedCore<StorageT>} {
+        // Reference held by the future's core until the value is forwarded, and
+        // dropped again if the callback cannot be set, as with no executor
+        core_->acquire();
+        try {
+            future.core_->setCallback(core_.get());
+        } catch(...) {
+            core_->release();
+            throw;
+        }
+        future.core_ = {};
+    }
+
+    // Blocks until the value is available and returns a reference to it, valid while
+    // any copy of this future exists
+    const StorageT& get() const {
+        return core_->get();
+    }
+
+    bool ready() const {
+        return core_->ready();
+    }
+
+    // Run callback on exec with a const reference to the value
+    template<class F, class R = shared_then_result_t<std::decay_t<F>&, T>>
+    ContinuableFuture<R> then(std::shared_ptr<DrivenExecutor> exec, F&& callback) {
+        auto next = new SharedThenCore<T, R, std::decay_t<F>>(std::forward<F>(callback));
+        CorePtr<CoreBase<lift_unit_t<R>>> nextCore{next};
+        next->executor_ = exec.get();
+        next->setExecutor(std::move(exec));
+        // The shared core holds a reference to the next until the callback has run
+        next->acquire();
+        core_->addContinuation(next);
+        return ContinuableFuture<R>{std::move(nextCore)};
+    }
+
+private:
+    CorePtr<SharedCore<StorageT>> core_;
+};
@@ -0,0 +1,96 @@
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Executor.h"
+#include "MyAsyncLibrary.h"
+#include "SharedFuture.h"
+
+int main() {
+    where("main()");
+
+    {
+        where("Shared future with consumers on two executors");
+        auto exec1 = std::make_shared<DrivenExecutor>();
+        auto exec2 = std::make_shared<DrivenExecutor>();
+        Promise<std::string> p;
+        SharedFuture<std::string> sf{p.get_future().via(exec1)};
+
+        constexpr int consumers = 200;
+        std::atomic<int> count = 0;
+        std::vector<const std::string*> seen(consumers + 1);
+        std::vector<ContinuableFuture<std::size_t>> results;
+        for(int i = 0; i < consumers; ++i) {
+            results.push_back(sf.then(i % 2 ? exec1 : exec2, [&, i](const std::string& s){
+                    seen[i] = &s;
+                    ++count;
+                    return s.size();
+                }));
+        }
+        auto t1 = std::thread([&](){
+                exec1->run();
+            });
+        auto t2 = std::thread([&](){
+                exec2->run();
+            });
+        p.set_value("a cached result");
+        std::size_t total = 0;
+        for(auto& r : results) {
+            total += r.get();
+        }
+
+        // A consumer added after completion is dispatched immediately
+        auto late = sf.then(exec2, [&](const std::string& s){ seen[consumers] = &s; ++count; });
+        late.get();
+        exec1->terminate();
+        exec2->terminate();
+        t1.join();
+        t2.join();
+
+        bool sameValue = true;
+        for(auto s : seen) {
+            sameValue = sameValue && s == &sf.get();
+        }
+        std::cout << "Value: " << sf.get() << ", consumers: " << count
+                  << ", all saw the same object: " << sameValue
+                  << ", total size: " << total << "\n";
+    }
+
+    {
+        where("Shared future of void");
+        auto exec = std::make_shared<DrivenExecutor>();
+        Promise<void> p;
+        SharedFuture<void> sf{p.get_future().via(exec)};
+        std::atomic<int> count = 0;
+        auto a = sf.then(exec, [&](){ ++count; });
+        auto b = sf.then(exec, [&](){ ++count; return 1; });
+        auto t = std::thread([&](){
+                exec->run();
+            });
+        p.set_value();
+        a.get();
+        b.get();
+        exec->terminate();
+        t.join();
+        std::cout << "Void consumers: " << count << "\n";
+    }
+
+    {
+        where("Shared future without an executor");
+        Promise<int> p;
+        bool rejected = false;
+        try {
+            SharedFuture<int> sf{p.get_future().via(nullptr)};
+        } catch(const std::logic_error&) {
+            rejected = true;
+        }
+        std::cout << "Rejected: " << rejected << "\n";
+    }
+
+    std::cout << "END\n";
+
+    return 0;
+}
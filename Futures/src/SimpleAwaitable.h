@@ -112,7 +112,7 @@ struct SyncAwaitAwaitable {
                 return final_suspend_result{this};
             }
 
-            void return_value(T val) {
+            void return_value(T&& val) {
                 value = std::move(val);
             }
 
@@ -127,7 +127,7 @@ struct SyncAwaitAwaitable {
     T get() {
         coroutine_handle_.promise().executor->execute([this](){coroutine_handle_.resume();});
         coroutine_handle_.promise().executor->run();
-        return coroutine_handle_.promise().value;
+        return std::move(coroutine_handle_.promise().value);
     }
 
     handle coroutine_handle_;
@@ -137,8 +137,8 @@ template<class Awaitable, class T = std::decay_t<decltype(std::declval<Awaitable
 auto sync_await(Awaitable&& aw) -> T {
     return  
         [&]() -> SyncAwaitAwaitable<T> {
-            int val = co_await std::forward<Awaitable>(aw);
-            co_return val;
+            T val = co_await std::forward<Awaitable>(aw);
+            co_return std::move(val);
         }().get();
 }
 
@@ -0,0 +1,85 @@
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include "bulk_algorithms.h"
+
+using Value = unsigned;
+
+template<class Executor>
+void runAlgorithms(const char* name, Executor executor, const std::vector<Value>& values,
+                   const std::vector<Value>& inclusive, const std::vector<Value>& exclusive,
+                   unsigned long long sumOfSquares, const std::vector<long>& counts) {
+  const int size = static_cast<int>(values.size());
+  std::vector<Value> out(size);
+  bool correct = true;
+  const double inclusiveMs = time_per_run([&](){
+    bulk_scan(executor, values.data(), out.data(), size, Value{0}, std::plus<>{}, true);
+  });
+  correct = correct && out == inclusive;
+  const double exclusiveMs = time_per_run([&](){
+    bulk_scan(executor, values.data(), out.data(), size, Value{0}, std::plus<>{}, false);
+  });
+  correct = correct && out == exclusive;
+  unsigned long long reduced = 0;
+  const double reduceMs = time_per_run([&](){
+    reduced = std::move(executor.template then_execute<unsigned long long>(
+      transform_reduce<Value>(0ull, [](Value v){ return static_cast<unsigned long long>(v) * v; }, std::plus<>{}),
+      TrivialFuture<Span<Value>>{Span<Value>{values.data(), size}})).get();
+  });
+  correct = correct && reduced == sumOfSquares;
+  std::vector<long> histogramCounts;
+  const double histogramMs = time_per_run([&](){
+    histogramCounts = std::move(executor.template then_execute<std::vector<long>>(
+      histogram<Value>(256, [](Value v){ return v & 255; }),
+      TrivialFuture<Span<Value>>{Span<Value>{values.data(), size}})).get();
+  });
+  correct = correct && histogramCounts == counts;
+  std::cout << "  " << name << ": inclusive_scan " << inclusiveMs << "ms, exclusive_scan " << exclusiveMs
+            << "ms, transform_reduce " << reduceMs << "ms, histogram " << histogramMs << "ms, correct " << correct << "\n";
+}
+
+// Sizes from 10^6 to 10^maxExponent, default 10^8. 10^9 needs about 12GB of memory.
+int main(int argc, char** argv) {
+  const int maxExponent = argc > 1 ? std::atoi(argv[1]) : 8;
+  ThreadPool pool{default_pool_size(1)};
+
+  int size = 1000000;
+  for(int exponent = 6; exponent <= maxExponent; ++exponent, size *= 10) {
+    std::vector<Value> values(size);
+    for(int i = 0; i < size; ++i) {
+      values[i] = static_cast<Value>(i) * 2654435761u >> 20;
+    }
+
+    std::vector<Value> inclusive(size);
+    std::vector<Value> exclusive(size);
+    unsigned long long sumOfSquares = 0;
+    std::vector<long> counts(256);
+    const double inclusiveMs = time_per_run([&](){
+      std::inclusive_scan(values.begin(), values.end(), inclusive.begin());
+    });
+    const double exclusiveMs = time_per_run([&](){
+      std::exclusive_scan(values.begin(), values.end(), exclusive.begin(), Value{0});
+    });
+    const double reduceMs = time_per_run([&](){
+      sumOfSquares = std::transform_reduce(values.begin(), values.end(), 0ull, std::plus<>{},
+        [](Value v){ return static_cast<unsigned long long>(v) * v; });
+    });
+    const double histogramMs = time_per_run([&](){
+      for(Value v : values) {
+        ++counts[v & 255];
+      }
+    });
+
+    std::cout << "10^" << exponent << " elements, " << pool.size() + 1 << " threads:\n"
+              << "  <numeric>: inclusive_scan " << inclusiveMs << "ms, exclusive_scan " << exclusiveMs
+              << "ms, transform_reduce " << reduceMs << "ms, histogram loop " << histogramMs << "ms\n";
+    runAlgorithms("EndDriver", DriverExecutor<EndDriver>{}, values, inclusive, exclusive, sumOfSquares, counts);
+    runAlgorithms("ParallelDriver", DriverExecutor<ParallelDriver>{ParallelDriver{pool}}, values, inclusive, exclusive,
+                  sumOfSquares, counts);
+  }
+
+  return 0;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "bulk_model.h"
+
+// Parallel algorithms built as bulk continuations, so that they run under any driver.
+// Each works on blocks of elements: the shape is the number of blocks, so a driver
+// hands out runs of whole blocks however it partitions the shape.
+
+// Elements to read, by pointer so that no stage copies them
+template<class T>
+struct Span {
+  const T* data_;
+  int size_;
+};
+
+inline int block_count(int size, int blockSize) {
+  return (size + blockSize - 1) / blockSize;
+}
+
+// op(init, transform(x)) folded over every element. Partials are privatized, one per
+// driver slot, and merged with op, so op must be associative and commutative. A
+// partial starts empty rather than from init so that init is counted once.
+template<class T, class R, class Transform, class Op>
+auto transform_reduce(R init, Transform transform, Op op, int blockSize = 1 << 14) {
+  using Partial = std::optional<R>;
+  return bulk_then_value(
+    range_body([transform, op, blockSize](const Span<T>& in, int begin, int end, Partial& shared) mutable {
+      const int first = begin * blockSize;
+      const int last = std::min(end * blockSize, in.size_);
+      if(first >= last) {
+        return;
+      }
+      R acc = shared ? std::move(*shared) : transform(in.data_[first]);
+      for(int i = shared ? first : first + 1; i < last; ++i) {
+        acc = op(std::move(acc), transform(in.data_[i]));
+      }
+      shared = std::move(acc);
+    }),
+    [blockSize](const Span<T>& in){return block_count(in.size_, blockSize);},
+    privatized(
+      [](const int& /*shape*/, const Span<T>& /*input*/){return Partial{};},
+      [op](Partial&& lhs, Partial&& rhs) mutable {
+        if(lhs && rhs) {
+          return Partial{op(std::move(*lhs), std::move(*rhs))};
+        }
+        return lhs ? std::move(lhs) : std::move(rhs);
+      }),
+    [init, op](Partial&& shared, auto& outputPromise) mutable {
+      outputPromise.set_value(shared ? op(std::move(init), std::move(*shared)) : std::move(init));
+    });
+}
+
+// Count of elements in each of bins bins, where binOf(x) picks the bin of x. Each
+// slot fills a private histogram and the histograms are summed in done.
+template<class T, class BinOf>
+auto histogram(int bins, BinOf binOf, int blockSize = 1 << 14) {
+  using Histogram = std::vector<long>;
+  return bulk_then_value(
+    range_body([binOf, blockSize](const Span<T>& in, int begin, int end, Histogram& shared) mutable {
+      const int first = begin * blockSize;
+      const int last = std::min(end * blockSize, in.size_);
+      for(int i = first; i < last; ++i) {
+        ++shared[binOf(in.data_[i])];
+      }
+    }),
+    [blockSize](const Span<T>& in){return block_count(in.size_, blockSize);},
+    privatized(
+      [bins](const int& /*shape*/, const Span<T>& /*input*/){return Histogram(bins);},
+      [](Histogram&& lhs, Histogram&& rhs){
+        for(std::size_t b = 0; b < lhs.size(); ++b) {
+          lhs[b] += rhs[b];
+        }
+        return std::move(lhs);
+      }),
+    [](Histogram&& shared, auto& outputPromise) {
+      outputPromise.set_value(std::move(shared));
+    });
+}
+
+// A scan is two bulk passes over the same blocks. The first reduces each block, done
+// turns the block sums into the offset each block starts from, and the second scans
+// each block from its offset into the output.
+template<class T>
+struct ScanInput {
+  const T* data_;
+  T* out_;
+  int size_;
+};
+
+template<class T>
+struct ScanState {
+  ScanInput<T> input_;
+  std::vector<T> offsets_;
+};
+
+template<class T, class Op>
+auto scan_reduce_blocks(T init, Op op, int blockSize = 1 << 14) {
+  return bulk_then_value(
+    range_body([op, blockSize](const ScanInput<T>& in, int begin, int end, std::vector<T>& sums) mutable {
+      for(int block = begin; block < end; ++block) {
+        const int first = block * blockSize;
+        const int last = std::min(first + blockSize, in.size_);
+        T acc = in.data_[first];
+        for(int i = first + 1; i < last; ++i) {
+          acc = op(std::move(acc), in.data_[i]);
+        }
+        sums[block] = std::move(acc);
+      }
+    }),
+    [blockSize](const ScanInput<T>& in){return block_count(in.size_, blockSize);},
+    [](const int& shape, const ScanInput<T>& /*input*/){return std::vector<T>(shape);},
+    [init, op](std::vector<T>&& sums, auto& outputPromise) mutable {
+      // Offsets are an exclusive scan of the block sums, serial as there are few blocks
+      T acc = init;
+      for(auto& sum : sums) {
+        acc = op(acc, std::exchange(sum, acc));
+      }
+      outputPromise.set_value(std::move(sums));
+    });
+}
+
+template<class T, class Op>
+auto scan_write_blocks(Op op, bool inclusive, int blockSize = 1 << 14) {
+  return bulk_then_value(
+    range_body([op, inclusive, blockSize](const ScanState<T>& state, int begin, int end, int& /*shared*/) mutable {
+      const ScanInput<T>& in = state.input_;
+      for(int block = begin; block < end; ++block) {
+        const int first = block * blockSize;
+        const int last = std::min(first + blockSize, in.size_);
+        T acc = state.offsets_[block];
+        if(inclusive) {
+          for(int i = first; i < last; ++i) {
+            acc = op(std::move(acc), in.data_[i]);
+            in.out_[i] = acc;
+          }
+        } else {
+          for(int i = first; i < last; ++i) {
+            in.out_[i] = acc;
+            acc = op(std::move(acc), in.data_[i]);
+          }
+        }
+      }
+    }),
+    [](const ScanState<T>& state){return static_cast<int>(state.offsets_.size());},
+    [](const int& /*shape*/, const ScanState<T>& /*input*/){return 0;},
+    [](int&& /*shared*/, auto& outputPromise) {
+      outputPromise.set_value(true);
+    });
+}
+
+// Scan [data, data + size) into out, as std::inclusive_scan or std::exclusive_scan
+// with init, by running both passes on executor
+template<class T, class Executor, class Op>
+void bulk_scan(Executor& executor, const T* data, T* out, int size, T init, Op op, bool inclusive, int blockSize = 1 << 14) {
+  if(size == 0) {
+    return;
+  }
+  ScanInput<T> input{data, out, size};
+  auto offsets = std::move(executor.template then_execute<std::vector<T>>(
+    scan_reduce_blocks<T>(init, op, blockSize), TrivialFuture<ScanInput<T>>{input})).get();
+  executor.template then_execute<bool>(
+    scan_write_blocks<T>(op, inclusive, blockSize), TrivialFuture<ScanState<T>>{ScanState<T>{input, std::move(offsets)}});
+}
@@ -0,0 +1,1517 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// The bulk model from cleaner_bulk_model.cpp, shared by the experiments that build
+// on it.
+
+template<class T>
+class TrivialFuture {
+public:
+  TrivialFuture(T val) : val_{std::move(val)} {}
+
+  T get() && {
+    return std::move(val_);
+  }
+
+private:
+  T val_;
+};
+
+// Order in which a tiled shape walks its tiles. Morton interleaves the bits of the
+// tile coordinates so that tiles close in the walk are close in every dimension.
+enum class TileOrder {
+  RowMajor,
+  Morton
+};
+
+// One tile of a tiled shape, the half-open box [begin_, end_) in each dimension
+template<std::size_t Rank>
+struct Tile {
+  std::array<int, Rank> begin_;
+  std::array<int, Rank> end_;
+};
+
+// Call f with each index of the tile as a std::array, last dimension fastest
+template<std::size_t Rank, class F>
+void for_each_index(const Tile<Rank>& tile, F&& f) {
+  for(std::size_t d = 0; d < Rank; ++d) {
+    if(tile.begin_[d] >= tile.end_[d]) {
+      return;
+    }
+  }
+  std::array<int, Rank> idx = tile.begin_;
+  while(true) {
+    f(static_cast<const std::array<int, Rank>&>(idx));
+    std::size_t d = Rank;
+    while(d > 0) {
+      --d;
+      if(++idx[d] < tile.end_[d]) {
+        break;
+      }
+      idx[d] = tile.begin_[d];
+      if(d == 0) {
+        return;
+      }
+    }
+  }
+}
+
+// A shape of Rank dimensions cut into tiles. The unit of work a driver hands out is
+// a tile, numbered in walk order, so a contiguous block of work is a run of tiles
+// that is compact in space rather than a band of flattened indices. Tile sizes must
+// be positive and extents not negative.
+template<std::size_t Rank>
+class TiledShape {
+public:
+  TiledShape(std::array<int, Rank> extents, std::array<int, Rank> tileSize, TileOrder order = TileOrder::RowMajor) :
+      extents_{extents}, tileSize_{tileSize} {
+    std::array<int, Rank> grid;
+    for(std::size_t d = 0; d < Rank; ++d) {
+      if(tileSize_[d] <= 0 || extents_[d] < 0) {
+        throw std::logic_error("TiledShape needs positive tile sizes and non-negative extents");
+      }
+      grid[d] = extents_[d] / tileSize_[d] + (extents_[d] % tileSize_[d] != 0);
+    }
+    if(order == TileOrder::RowMajor) {
+      walkRowMajor(grid);
+    } else {
+      walkMorton(grid);
+    }
+  }
+
+  // Number of units of work
+  int size() const {
+    return static_cast<int>(tiles_.size());
+  }
+
+  Tile<Rank> tile(int t) const {
+    Tile<Rank> result;
+    for(std::size_t d = 0; d < Rank; ++d) {
+      result.begin_[d] = tiles_[t][d] * tileSize_[d];
+      result.end_[d] = std::min(result.begin_[d] + tileSize_[d], extents_[d]);
+    }
+    return result;
+  }
+
+  const std::array<int, Rank>& extents() const {
+    return extents_;
+  }
+
+private:
+  void walkRowMajor(const std::array<int, Rank>& grid) {
+    for_each_index(Tile<Rank>{std::array<int, Rank>{}, grid}, [this](const std::array<int, Rank>& t){
+      tiles_.push_back(t);
+    });
+  }
+
+  // Walk Morton codes over the power of two grid that covers the tile grid and skip
+  // those outside it. Decoding is done once here so tile(t) is a lookup. A grid whose
+  // codes do not fit in 64 bits, or so skewed that most of the covering grid would
+  // be skipped, is walked in row-major order instead, as is a single tile, which has
+  // no bits to interleave.
+  void walkMorton(const std::array<int, Rank>& grid) {
+    int bits = 0;
+    std::uint64_t tiles = 1;
+    for(std::size_t d = 0; d < Rank; ++d) {
+      if(grid[d] == 0) {
+        return;
+      }
+      while((std::int64_t{1} << bits) < grid[d]) {
+        ++bits;
+      }
+      tiles *= static_cast<std::uint64_t>(grid[d]);
+    }
+    if(bits == 0 || bits * Rank >= 64 || (std::uint64_t{1} << (bits * Rank - Rank)) > tiles) {
+      walkRowMajor(grid);
+      return;
+    }
+    const std::uint64_t codes = std::uint64_t{1} << (bits * Rank);
+    for(std::uint64_t code = 0; code < codes; ++code) {
+      std::array<int, Rank> t{};
+      for(int b = 0; b < bits; ++b) {
+        for(std::size_t d = 0; d < Rank; ++d) {
+          // The last dimension takes the lowest bit, as in row-major
+          t[d] |= static_cast<int>((code >> (b * Rank + (Rank - 1 - d))) & 1) << b;
+        }
+      }
+      bool inside = true;
+      for(std::size_t d = 0; d < Rank; ++d) {
+        inside = inside && t[d] < grid[d];
+      }
+      if(inside) {
+        tiles_.push_back(t);
+      }
+    }
+  }
+
+  std::array<int, Rank> extents_;
+  std::array<int, Rank> tileSize_;
+  std::vector<std::array<int, Rank>> tiles_;
+};
+
+template<class ShapeT>
+struct is_tiled_shape : std::false_type {};
+
+template<std::size_t Rank>
+struct is_tiled_shape<TiledShape<Rank>> : std::true_type {};
+
+// Number of units of work in a shape, which drivers split into ranges
+inline int bulk_size(int shape) {
+  return shape;
+}
+
+template<std::size_t Rank>
+int bulk_size(const TiledShape<Rank>& shape) {
+  return shape.size();
+}
+
+// A shape known at compile time, returned from a shape factory in place of an int,
+// [](const InputT&){return static_shape<16>{};}. It converts to int, so shared
+// factories taking the shape as an int need no change. A block that covers a whole
+// static shape of at most max_unrolled_shape indices, as with EndDriver, runs with
+// the loop over its indices fully unrolled. A parallel driver still splits such a
+// shape across its threads, and its smaller blocks run the ordinary loop.
+template<int N>
+using static_shape = std::integral_constant<int, N>;
+
+constexpr int max_unrolled_shape = 256;
+
+template<class ShapeT>
+struct is_static_shape : std::false_type {};
+
+template<int N>
+struct is_static_shape<std::integral_constant<int, N>> : std::true_type {};
+
+template<class ShapeT>
+constexpr bool is_unrolled_shape() {
+  if constexpr(is_static_shape<ShapeT>::value) {
+    return ShapeT::value <= max_unrolled_shape;
+  } else {
+    return false;
+  }
+}
+
+template<int N>
+constexpr int bulk_size(std::integral_constant<int, N>) {
+  return N;
+}
+
+// Drivers hand units of work to the promise as contiguous ranges, atF(begin, end),
+// so that a range body sees a whole block at once. atF(i) still runs a single unit.
+// A unit is an index for an int shape and a tile for a tiled shape.
+
+// Custom default driver for this promise
+template<class PromiseT>
+struct DefaultDriverImpl {
+  void start() {
+    promise_.execute_range(0, bulk_size(promise_.get_shape()));
+    promise_.done();
+  }
+
+  void end() {
+  }
+
+  PromiseT& promise_;
+};
+
+struct DefaultDriver {
+  template<class PromiseT>
+  auto operator()(PromiseT& prom){
+    return DefaultDriverImpl<PromiseT>{prom};
+  }
+  template<class PromiseT, class ShapeF, class AtF, class DoneF>
+  auto operator()(PromiseT& prom, ShapeF&&, AtF&&, DoneF&&){
+    return DefaultDriverImpl<PromiseT>{prom};
+  }
+};
+
+template<class PromiseT, class ShapeF, class AtF, class DoneF>
+struct EndDriverImpl {
+  void start() {
+  }
+
+  void end() {
+    atF_(0, bulk_size(shapeF_()));
+    doneF_();
+  }
+
+  PromiseT& promise_;
+  ShapeF shapeF_;
+  AtF atF_;
+  DoneF doneF_;
+};
+
+struct EndDriver {
+  template<class PromiseT, class ShapeF, class AtF, class DoneF>
+  auto operator()(PromiseT& prom, ShapeF&& shapeF, AtF&& atF, DoneF&& doneF){
+    return EndDriverImpl<PromiseT, ShapeF, AtF, DoneF>{
+      prom,
+      std::forward<ShapeF>(shapeF),
+      std::forward<AtF>(atF),
+      std::forward<DoneF>(doneF)};
+  }
+};
+
+// Worker count for a pool on this machine: a thread per hardware thread less the
+// ones reserved for callers that work alongside the pool, and never less than one.
+// hardware_concurrency may report 0 when it cannot tell.
+inline std::size_t default_pool_size(std::size_t reserved = 0) {
+  const std::size_t threads = std::thread::hardware_concurrency();
+  return threads > reserved ? threads - reserved : 1;
+}
+
+// Mean wall-clock time of runs calls of f, in the units of Duration, milliseconds
+// unless given. The examples time their runs with this.
+template<class Duration = std::chrono::duration<double, std::milli>, class F>
+double time_per_run(F&& f, int runs = 1) {
+  const auto start = std::chrono::steady_clock::now();
+  for(int r = 0; r < runs; ++r) {
+    f();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<Duration>(end - start).count() / runs;
+}
+
+// Fixed set of worker threads sharing one task queue
+class ThreadPool {
+public:
+  explicit ThreadPool(std::size_t threadCount = default_pool_size()) {
+    if(threadCount == 0) {
+      threadCount = 1;
+    }
+    for(std::size_t i = 0; i < threadCount; ++i) {
+      workers_.emplace_back([this](){ run(); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::unique_lock<std::mutex> lock(queueLock_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    for(auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  void execute(std::function<void()> task) {
+    {
+      std::unique_lock<std::mutex> lock(queueLock_);
+      tasks_.push(std::move(task));
+    }
+    cv_.notify_one();
+  }
+
+  std::size_t size() const {
+    return workers_.size();
+  }
+
+private:
+  void run() {
+    while(true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(queueLock_);
+        cv_.wait(lock, [this](){ return stopping_ || !tasks_.empty(); });
+        if(tasks_.empty()) {
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop();
+      }
+      task();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex queueLock_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+};
+
+// Driver that splits the shape into one contiguous block per worker and the calling
+// thread. Whichever block finishes last calls done, so done runs exactly once and
+// only after every index. end blocks until then because the executors read the
+// output as soon as end returns.
+template<class PromiseT, class ShapeF, class AtF, class DoneF>
+struct ParallelDriverImpl {
+  void start() {
+  }
+
+  // Each block runs on one thread at a time so may own a private partial state
+  std::size_t slots() const {
+    return pool_.size() + 1;
+  }
+
+  void end() {
+    const int shape = bulk_size(shapeF_());
+    using IndexT = int;
+    const IndexT blocks = static_cast<IndexT>(pool_.size() + 1);
+    // In 64 bits, as a shape near INT_MAX would overflow an int
+    const std::int64_t blockSize = (std::int64_t{shape} + blocks - 1) / blocks;
+
+    std::atomic<IndexT> remaining{blocks};
+    std::mutex doneLock;
+    std::condition_variable doneCv;
+    bool finished = false;
+
+    auto runBlock = [&](IndexT block) {
+      const IndexT begin = static_cast<IndexT>(std::min<std::int64_t>(block * blockSize, shape));
+      const IndexT end = static_cast<IndexT>(std::min<std::int64_t>(begin + blockSize, shape));
+      if(begin < end) {
+        atF_(begin, end, static_cast<std::size_t>(block));
+      }
+      if(remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        doneF_();
+        std::unique_lock<std::mutex> lock(doneLock);
+        finished = true;
+        doneCv.notify_one();
+      }
+    };
+
+    for(IndexT block = 1; block < blocks; ++block) {
+      pool_.execute([&runBlock, block](){ runBlock(block); });
+    }
+    runBlock(0);
+
+    std::unique_lock<std::mutex> lock(doneLock);
+    doneCv.wait(lock, [&](){ return finished; });
+  }
+
+  PromiseT& promise_;
+  ShapeF shapeF_;
+  AtF atF_;
+  DoneF doneF_;
+  ThreadPool& pool_;
+};
+
+struct ParallelDriver {
+  template<class PromiseT, class ShapeF, class AtF, class DoneF>
+  auto operator()(PromiseT& prom, ShapeF&& shapeF, AtF&& atF, DoneF&& doneF){
+    return ParallelDriverImpl<PromiseT, ShapeF, AtF, DoneF>{
+      prom,
+      std::forward<ShapeF>(shapeF),
+      std::forward<AtF>(atF),
+      std::forward<DoneF>(doneF),
+      pool_};
+  }
+
+  ThreadPool& pool_;
+};
+
+// Pool where each worker has its own deque of tasks. A worker takes its newest task
+// first, so work it splits off stays in its cache, and when its deque is empty it
+// steals the oldest task, the biggest piece of work, from another worker.
+class WorkStealingPool {
+public:
+  explicit WorkStealingPool(std::size_t threadCount = default_pool_size()) :
+      queues_(threadCount == 0 ? 1 : threadCount) {
+    for(std::size_t i = 0; i < queues_.size(); ++i) {
+      workers_.emplace_back([this, i](){ run(i); });
+    }
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::unique_lock<std::mutex> lock(sleepLock_);
+      stopping_ = true;
+    }
+    sleepCv_.notify_all();
+    for(auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  // A worker pushes onto its own deque, any other thread spreads tasks round robin
+  void execute(std::function<void()> task) {
+    const int index = worker_index();
+    Queue& queue = queues_[index >= 0 ? index : next_++ % queues_.size()];
+    {
+      std::unique_lock<std::mutex> lock(queue.lock_);
+      queue.tasks_.push_back(std::move(task));
+    }
+    {
+      std::unique_lock<std::mutex> lock(sleepLock_);
+      ++pending_;
+    }
+    sleepCv_.notify_one();
+  }
+
+  // Whether the calling worker has nothing queued, which is when splitting pays
+  bool local_queue_empty() {
+    const int index = worker_index();
+    if(index < 0) {
+      return true;
+    }
+    std::unique_lock<std::mutex> lock(queues_[index].lock_);
+    return queues_[index].tasks_.empty();
+  }
+
+  std::size_t size() const {
+    return workers_.size();
+  }
+
+  // Index of this pool's worker running the calling thread, or -1 for any other
+  // thread, including the workers of other pools
+  int worker_index() const {
+    return worker_.pool_ == this ? worker_.index_ : -1;
+  }
+
+private:
+  struct Queue {
+    std::mutex lock_;
+    std::deque<std::function<void()>> tasks_;
+  };
+
+  // The pool a worker thread belongs to is kept with its index, as one thread_local
+  // serves every pool
+  struct Worker {
+    const WorkStealingPool* pool_;
+    int index_;
+  };
+
+  bool take(std::size_t index, std::function<void()>& task) {
+    for(std::size_t i = 0; i < queues_.size(); ++i) {
+      Queue& queue = queues_[(index + i) % queues_.size()];
+      std::unique_lock<std::mutex> lock(queue.lock_);
+      if(!queue.tasks_.empty()) {
+        if(i == 0) {
+          task = std::move(queue.tasks_.back());
+          queue.tasks_.pop_back();
+        } else {
+          task = std::move(queue.tasks_.front());
+          queue.tasks_.pop_front();
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run(std::size_t index) {
+    worker_ = Worker{this, static_cast<int>(index)};
+    while(true) {
+      {
+        std::unique_lock<std::mutex> lock(sleepLock_);
+        sleepCv_.wait(lock, [this](){ return stopping_ || pending_ > 0; });
+        if(pending_ == 0) {
+          return;
+        }
+        --pending_;
+      }
+      // pending_ counted one task for us, which is in some deque until we find it
+      std::function<void()> task;
+      while(!take(index, task)) {
+        std::this_thread::yield();
+      }
+      task();
+    }
+  }
+
+  std::vector<Queue> queues_;
+  std::vector<std::thread> workers_;
+  std::atomic<std::size_t> next_{0};
+  std::mutex sleepLock_;
+  std::condition_variable sleepCv_;
+  std::size_t pending_ = 0;
+  bool stopping_ = false;
+  static inline thread_local Worker worker_{nullptr, -1};
+};
+
+// How a StealingDriver hands out ranges of the shape
+enum class Schedule {
+  // One block per worker, as ParallelDriver does
+  Static,
+  // Lazy binary splitting: a worker runs its range a grain at a time and splits off
+  // the upper half for others to steal only while its own deque is empty, so ranges
+  // are split as often as there are idle workers and no more
+  Dynamic,
+  // Workers claim chunks from a shared cursor, each a fixed fraction of what is
+  // left, so chunks start large and shrink to the grain towards the end
+  Guided
+};
+
+// Driver that runs the shape on a WorkStealingPool with a choice of schedule. A
+// grain of zero picks one that gives each worker about sixteen chunks. The calling
+// thread waits in end. Each worker runs one range at a time, so it is a slot.
+template<class PromiseT, class ShapeF, class AtF, class DoneF>
+struct StealingDriverImpl {
+  void start() {
+  }
+
+  std::size_t slots() const {
+    return pool_.size();
+  }
+
+  void end() {
+    const int shape = bulk_size(shapeF_());
+    const int workers = static_cast<int>(pool_.size());
+    Run run{shape, grain_ > 0 ? grain_ : std::max(1, shape / (workers * 16))};
+    if(shape == 0) {
+      doneF_();
+      return;
+    }
+
+    if(schedule_ == Schedule::Static) {
+      const std::int64_t blockSize = (std::int64_t{shape} + workers - 1) / workers;
+      for(int begin = 0; begin < shape;) {
+        const int end = static_cast<int>(std::min<std::int64_t>(begin + blockSize, shape));
+        spawn(run, [this, &run, begin, end](){ atF_(begin, end, slot()); });
+        begin = end;
+      }
+    } else if(schedule_ == Schedule::Dynamic) {
+      spawn(run, [this, &run](){ split(run, 0, run.shape_); });
+    } else {
+      for(int w = 0; w < workers; ++w) {
+        spawn(run, [this, &run, workers](){ claimGuided(run, workers); });
+      }
+    }
+    finish(run);
+
+    std::unique_lock<std::mutex> lock(run.doneLock_);
+    run.doneCv_.wait(lock, [&run](){ return run.finished_; });
+  }
+
+  // State of one run, which lives in end until done has been called
+  struct Run {
+    Run(int shape, int grain) : shape_{shape}, grain_{grain} {}
+
+    const int shape_;
+    const int grain_;
+    // end holds one count while it spawns the first tasks
+    std::atomic<int> tasks_{1};
+    std::atomic<int> cursor_{0};
+    std::mutex doneLock_;
+    std::condition_variable doneCv_;
+    bool finished_ = false;
+  };
+
+  std::size_t slot() const {
+    return static_cast<std::size_t>(pool_.worker_index());
+  }
+
+  // Tasks are counted before they are queued and are only spawned by end or by a
+  // counted task, so the count reaches zero once, when the last of them finishes.
+  // That one calls done and touches nothing afterwards.
+  template<class Task>
+  void spawn(Run& run, Task task) {
+    run.tasks_.fetch_add(1, std::memory_order_relaxed);
+    pool_.execute([this, &run, task = std::move(task)]() mutable {
+      task();
+      finish(run);
+    });
+  }
+
+  void finish(Run& run) {
+    if(run.tasks_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      doneF_();
+      std::unique_lock<std::mutex> lock(run.doneLock_);
+      run.finished_ = true;
+      run.doneCv_.notify_one();
+    }
+  }
+
+  void split(Run& run, int begin, int end) {
+    while(begin < end) {
+      while(end - begin > run.grain_ && pool_.local_queue_empty()) {
+        const int middle = begin + (end - begin) / 2;
+        spawn(run, [this, &run, middle, end](){ split(run, middle, end); });
+        end = middle;
+      }
+      const int chunkEnd = std::min(begin + run.grain_, end);
+      atF_(begin, chunkEnd, slot());
+      begin = chunkEnd;
+    }
+  }
+
+  void claimGuided(Run& run, int workers) {
+    int begin = run.cursor_.load(std::memory_order_relaxed);
+    while(begin < run.shape_) {
+      const int end = std::min(run.shape_, begin + std::max(run.grain_, (run.shape_ - begin) / (2 * workers)));
+      if(run.cursor_.compare_exchange_weak(begin, end, std::memory_order_relaxed)) {
+        atF_(begin, end, slot());
+        begin = run.cursor_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  PromiseT& promise_;
+  ShapeF shapeF_;
+  AtF atF_;
+  DoneF doneF_;
+  WorkStealingPool& pool_;
+  Schedule schedule_;
+  int grain_;
+};
+
+struct StealingDriver {
+  template<class PromiseT, class ShapeF, class AtF, class DoneF>
+  auto operator()(PromiseT& prom, ShapeF&& shapeF, AtF&& atF, DoneF&& doneF){
+    return StealingDriverImpl<PromiseT, ShapeF, AtF, DoneF>{
+      prom,
+      std::forward<ShapeF>(shapeF),
+      std::forward<AtF>(atF),
+      std::forward<DoneF>(doneF),
+      pool_,
+      schedule_,
+      grain_};
+  }
+
+  WorkStealingPool& pool_;
+  Schedule schedule_ = Schedule::Dynamic;
+  int grain_ = 0;
+};
+
+// Marks a body that takes a block of indices, f(input, begin, end, shared), instead
+// of one index at a time
+template<class F>
+struct RangeBody {
+  F f_;
+};
+
+template<class F>
+RangeBody<std::decay_t<F>> range_body(F&& f) {
+  return {std::forward<F>(f)};
+}
+
+template<class F>
+struct is_range_body : std::false_type {};
+
+template<class F>
+struct is_range_body<RangeBody<F>> : std::true_type {};
+
+// A body may return bulk_control instead of void. Returning stop skips every index
+// not yet started, for find and any_of style searches. Indices are handed to a
+// body in chunks of stop_grain and the stop flag is checked between chunks, so
+// with any driver at most one chunk per block runs after a stop.
+enum class bulk_control {
+  proceed,
+  stop
+};
+
+constexpr int stop_grain = 1024;
+
+template<class F, class... Args>
+constexpr bool returns_bulk_control = std::is_same_v<std::invoke_result_t<F&, Args...>, bulk_control>;
+
+// Shared factory whose state is privatized: each slot of the driver gets its own
+// state from factory and the states are merged with combine before the result
+// selector runs, so a reduction needs no atomics and threads never share a line.
+// See combineStates for when the merged result is reproducible.
+template<class SharedFactory, class Combine>
+struct Privatized {
+  template<class... Args>
+  auto operator()(Args&&... args) {
+    return factory_(std::forward<Args>(args)...);
+  }
+
+  // Present when the wrapped factory can reset a state in place
+  template<class StateT, class ShapeT, class InputT, class Factory = SharedFactory>
+  auto reset(StateT& state, const ShapeT& shape, const InputT& input)
+      -> decltype(std::declval<Factory&>().reset(state, shape, input)) {
+    return factory_.reset(state, shape, input);
+  }
+
+  SharedFactory factory_;
+  Combine combine_;
+};
+
+template<class SharedFactory, class Combine>
+Privatized<std::decay_t<SharedFactory>, std::decay_t<Combine>> privatized(SharedFactory&& factory, Combine&& combine) {
+  return {std::forward<SharedFactory>(factory), std::forward<Combine>(combine)};
+}
+
+template<class F>
+struct is_privatized : std::false_type {};
+
+template<class SharedFactory, class Combine>
+struct is_privatized<Privatized<SharedFactory, Combine>> : std::true_type {};
+
+// Shared factory that can also reset a state from an earlier run in place, with
+// reset(state, shape, input), so a plan that runs many times reuses the state's
+// buffers instead of building a new state each time
+template<class SharedFactory, class Reset>
+struct Resettable {
+  template<class... Args>
+  auto operator()(Args&&... args) {
+    return factory_(std::forward<Args>(args)...);
+  }
+
+  template<class StateT, class ShapeT, class InputT>
+  void reset(StateT& state, const ShapeT& shape, const InputT& input) {
+    reset_(state, shape, input);
+  }
+
+  SharedFactory factory_;
+  Reset reset_;
+};
+
+template<class SharedFactory, class Reset>
+Resettable<std::decay_t<SharedFactory>, std::decay_t<Reset>> resettable(SharedFactory&& factory, Reset&& reset) {
+  return {std::forward<SharedFactory>(factory), std::forward<Reset>(reset)};
+}
+
+template<class SharedFactory, class StateT, class ShapeT, class InputT, class = void>
+struct can_reset : std::false_type {};
+
+template<class SharedFactory, class StateT, class ShapeT, class InputT>
+struct can_reset<SharedFactory, StateT, ShapeT, InputT, std::void_t<decltype(
+    std::declval<SharedFactory&>().reset(std::declval<StateT&>(), std::declval<const ShapeT&>(), std::declval<const InputT&>()))>>
+  : std::true_type {};
+
+// Number of slots a driver runs concurrently, or one if it does not say
+template<class Driver, class = void>
+struct driver_slots {
+  static std::size_t get(const Driver&) {
+    return 1;
+  }
+};
+
+template<class Driver>
+struct driver_slots<Driver, std::void_t<decltype(std::declval<const Driver&>().slots())>> {
+  static std::size_t get(const Driver& driver) {
+    return driver.slots();
+  }
+};
+
+// Tag naming the input type, which an executor passes when it binds a driver so
+// that the promise can own storage for the input before the input arrives
+template<class T>
+struct input_type {
+  using type = T;
+};
+
+// The input is owned here, in one place, and every index sees it by const
+// reference, so a large input is moved in once and never copied
+template<class InputT, class F, class OutputPromise, class ShapeFactory, class SharedFactory, class ResultSelector, class BulkDriver>
+class InputPromise {
+public:
+  InputPromise(
+      F&& f, OutputPromise&& outputPromise, ShapeFactory&& shapeFactory, SharedFactory&& sharedFactory, ResultSelector&& resultSelector, BulkDriver&& bulk_driver) :
+      f_(std::move(f)),
+      outputPromise_(std::move(outputPromise)),
+      shapeFactory_{std::forward<ShapeFactory>(shapeFactory)},
+      sharedFactory_{sharedFactory},
+      resultSelector_{resultSelector},
+      bulkDriver_{std::forward<BulkDriver>(bulk_driver)} {}
+
+  void set_value(InputT&& value) {
+    inputValue_.emplace(std::move(value));
+    make_states();
+  }
+
+  void set_value(const InputT& value) {
+    inputValue_.emplace(value);
+    make_states();
+  }
+
+  void set_exception(std::exception_ptr e) {
+    if(!failed_.exchange(true)) {
+      outputException_ = std::move(e);
+    }
+    stopped_.store(true, std::memory_order_relaxed);
+  }
+
+  // Give the value as one chunk of a stream, as a BulkStream does. The states are
+  // made from the first chunk and carried across the rest, done leaves them for
+  // finish_stream, and an exception or a stop in one chunk skips the chunks after it.
+  void stream_value(InputT&& value) {
+    inputValue_.emplace(std::move(value));
+    if(!std::exchange(streaming_, true)) {
+      make_states();
+    } else {
+      shape_.emplace(shapeFactory_(*inputValue_));
+    }
+  }
+
+  // Complete the output from the states of every chunk streamed
+  void finish_stream() {
+    streaming_ = false;
+    complete();
+  }
+
+  // Whether chunks of one stream may run on several promises at once and have their
+  // states merged. A single shared state cannot be split, so only privatized ones.
+  static constexpr bool mergeable_states = is_privatized<SharedFactory>::value;
+
+  // Take the states of another promise that streamed chunks of the same stream, so
+  // that finish_stream combines them with these. The first exception is kept.
+  void merge_stream(InputPromise& other) {
+    static_assert(mergeable_states, "Only privatized states can be merged");
+    for(auto& slot : other.sharedData_) {
+      sharedData_.push_back(std::move(slot));
+    }
+    other.sharedData_.clear();
+    if(other.outputException_ && !outputException_) {
+      outputException_ = std::move(other.outputException_);
+    }
+  }
+
+  bool stopped() const {
+    return stopped_.load(std::memory_order_relaxed);
+  }
+
+  // Must be called before set_value so that a privatized state gets one copy per slot
+  auto bulk_driver() {
+    auto driver = bulkDriver_(
+      *this,
+      [this](){return this->get_shape();},
+      [this](auto begin, auto... end){
+        if constexpr(sizeof...(end) == 0) {
+          this->execute_at(begin);
+        } else {
+          this->execute_range(begin, end...);
+        }
+      },
+      [this](){this->done();});
+    slots_ = driver_slots<decltype(driver)>::get(driver);
+    return driver;
+  }
+
+private:
+  using ShapeT = std::invoke_result_t<ShapeFactory&, const InputT&>;
+  using SharedT = std::invoke_result_t<SharedFactory&, const ShapeT&, const InputT&>;
+
+  // Padded so that slots written by different threads never share a cache line
+  struct alignas(64) SharedSlot {
+    SharedT value_;
+  };
+
+  F f_;
+  OutputPromise outputPromise_;
+  ShapeFactory shapeFactory_;
+  SharedFactory sharedFactory_;
+  ResultSelector resultSelector_;
+  BulkDriver bulkDriver_;
+
+  std::optional<InputT> inputValue_;
+  std::optional<ShapeT> shape_;
+  std::vector<SharedSlot> sharedData_;
+  std::size_t slots_ = 1;
+  std::optional<std::exception_ptr> outputException_;
+  std::atomic<bool> failed_{false};
+  std::atomic<bool> stopped_{false};
+  bool streaming_ = false;
+
+  friend struct DefaultDriverImpl<InputPromise>;
+
+  // A promise may be given a value again once done has run, as a BulkPlan does, in
+  // which case the states of the last run are reset in place if the shared factory
+  // supports it and rebuilt in the same slots otherwise
+  void make_states() {
+    outputException_.reset();
+    failed_.store(false, std::memory_order_relaxed);
+    stopped_.store(false, std::memory_order_relaxed);
+    shape_.emplace(shapeFactory_(*inputValue_));
+    const std::size_t states = is_privatized<SharedFactory>::value ? slots_ : 1;
+    if constexpr(can_reset<SharedFactory, SharedT, ShapeT, InputT>::value) {
+      if(sharedData_.size() == states) {
+        for(auto& slot : sharedData_) {
+          sharedFactory_.reset(slot.value_, *shape_, *inputValue_);
+        }
+        return;
+      }
+    }
+    sharedData_.clear();
+    sharedData_.reserve(states);
+    for(std::size_t i = 0; i < states; ++i) {
+      sharedData_.push_back(SharedSlot{sharedFactory_(*shape_, *inputValue_)});
+    }
+  }
+
+  const ShapeT& get_shape() const {
+    return *shape_;
+  }
+
+  void execute_at(int idx) { // Should be templated Shape
+    execute_range(idx, idx + 1);
+  }
+
+  // The input is checked once per block and a per-index body is adapted by looping
+  // here, so the loop over the block is visible to the compiler either way.
+  // A driver with several slots passes the slot running the block.
+  // For a tiled shape the body is called once per tile, f(input, tile, shared).
+  // A per-index body over the whole of a small static shape is unrolled.
+  // An exception from the body is kept for done and stops the remaining indices.
+  void execute_range(int begin, int end, std::size_t slot = 0) {
+    if(!inputValue_ || stopped()) {
+      return;
+    }
+    const auto& input = *inputValue_;
+    auto& shared = sharedData_[is_privatized<SharedFactory>::value ? slot : 0].value_;
+    try {
+      if constexpr(is_tiled_shape<ShapeT>::value) {
+        static_assert(!is_range_body<F>::value, "A tiled shape hands its body one tile at a time");
+        for(int t = begin; t < end && !stopped(); ++t) {
+          run(f_, input, shape_->tile(t), shared);
+        }
+      } else if constexpr(is_range_body<F>::value) {
+        if constexpr(returns_bulk_control<decltype(f_.f_), const InputT&, int, int, SharedT&>) {
+          for(int chunk = begin; chunk < end && !stopped(); chunk += stop_grain) {
+            run(f_.f_, input, chunk, std::min(chunk + stop_grain, end), shared);
+          }
+        } else {
+          f_.f_(input, begin, end, shared);
+        }
+      } else {
+        if constexpr(is_unrolled_shape<ShapeT>()) {
+          if(begin == 0 && end == ShapeT::value) {
+            run_unrolled(input, shared, std::make_integer_sequence<int, ShapeT::value>{});
+            return;
+          }
+        }
+        for(int chunk = begin; chunk < end && !stopped(); chunk += stop_grain) {
+          const int chunkEnd = std::min(chunk + stop_grain, end);
+          for(int i = chunk; i < chunkEnd; ++i) {
+            if(!run(f_, input, i, shared)) {
+              return;
+            }
+          }
+        }
+      }
+    } catch(...) {
+      set_exception(std::current_exception());
+    }
+  }
+
+  // Call a body, raising the stop flag if it asks to stop. Returns whether to go on.
+  template<class Body, class... Args>
+  bool run(Body& body, Args&&... args) {
+    if constexpr(returns_bulk_control<Body, Args...>) {
+      if(body(std::forward<Args>(args)...) == bulk_control::stop) {
+        stopped_.store(true, std::memory_order_relaxed);
+        return false;
+      }
+    } else {
+      body(std::forward<Args>(args)...);
+    }
+    return true;
+  }
+
+  // Every index of a static shape, with no loop left to bound. A stop skips the rest.
+  template<int... Is>
+  void run_unrolled(const InputT& input, SharedT& shared, std::integer_sequence<int, Is...>) {
+    (run(f_, input, Is, shared) && ...);
+  }
+
+  // A streamed chunk is complete here but the output waits for finish_stream
+  void done() {
+    if(!streaming_) {
+      complete();
+    }
+  }
+
+  void complete() {
+    // An exception that leaks is dealt with directly here
+    // Optionally the resultSelector could also call set_exception if the
+    // exception was dealt with in the shared state
+    if(outputException_) {
+      outputPromise_.set_exception(*std::move(outputException_));
+    } else {
+      if constexpr(is_privatized<SharedFactory>::value) {
+        combineStates();
+      }
+      resultSelector_(std::move(sharedData_[0].value_), outputPromise_);
+    }
+  }
+
+  // Merge slot states pairwise up a binary tree over slot order. The result is the
+  // same on every run only if each slot is given the same indices every run, as the
+  // fixed blocks of ParallelDriver are. StealingDriver's slots are its workers and
+  // which indices a worker runs varies with stealing, so there a combine that is not
+  // associative and commutative, like floating-point addition, can vary run to run.
+  void combineStates() {
+    auto& combine = sharedFactory_.combine_;
+    for(std::size_t step = 1; step < sharedData_.size(); step *= 2) {
+      for(std::size_t i = 0; i + step < sharedData_.size(); i += 2 * step) {
+        sharedData_[i].value_ = combine(std::move(sharedData_[i].value_), std::move(sharedData_[i + step].value_));
+      }
+    }
+  }
+};
+
+
+template<class F, class ShapeFactory, class SharedFactory, class ResultSelector>
+auto bulk_then_value(
+    F&& continuationFunction,
+    ShapeFactory shapeFactory,
+    SharedFactory&& sharedFactory,
+    ResultSelector&& resultSelector) {
+  return [continuationFunction = std::forward<F>(continuationFunction),
+          shapeFactory = std::forward<ShapeFactory>(shapeFactory),
+          sharedFactory = std::forward<SharedFactory>(sharedFactory),
+          resultSelector = std::forward<ResultSelector>(resultSelector)](
+        auto&& outputPromise) mutable {
+    using OutputPromiseRef = decltype(outputPromise);
+    using OutputPromise = typename std::remove_reference<OutputPromiseRef>::type;
+
+    return [continuationFunction = std::forward<F>(continuationFunction),
+            shapeFactory = std::move(shapeFactory),
+            sharedFactory = std::move(sharedFactory),
+            resultSelector = std::move(resultSelector),
+            outputPromise = std::move(outputPromise)](
+          auto&& bulkDriver, auto inputType) mutable {
+      using BulkDriverRef = decltype(bulkDriver);
+      using BulkDriver = typename std::remove_reference<BulkDriverRef>::type;
+      using InputT = typename decltype(inputType)::type;
+
+      return InputPromise<InputT, std::decay_t<F>, OutputPromise, ShapeFactory, std::decay_t<SharedFactory>, std::decay_t<ResultSelector>, BulkDriver>(
+          std::move(continuationFunction),
+          std::move(outputPromise),
+          std::move(shapeFactory),
+          std::move(sharedFactory),
+          std::move(resultSelector),
+          std::forward<decltype(bulkDriver)>(bulkDriver));
+    };
+  };
+
+}
+
+// An element-wise stage, body(input, i, output), which writes index i of an output
+// made by outputFactory(shape, input) and reads only index i of its input. The
+// output is the stage's result. Adjacent element-wise stages can be fused so that
+// one sweep and one done barrier run them all.
+// Only stages built with elementwise or map_stage fuse. A chain of continuations
+// from the four-argument bulk_then_value is never fused, as nothing says that a
+// body reads only its own index. Fusion pays where per-sweep costs dominate, as for
+// short vectors, and where intermediates would otherwise fall out of cache. It
+// cannot help when each run allocates and first touches its outputs, as that costs
+// the same fused or not; map_stage avoids the intermediates altogether.
+template<class Body, class ShapeFactory, class OutputFactory>
+struct ElementwiseStage {
+  template<class InputT>
+  auto shape(const InputT& input) {
+    return shapeFactory_(input);
+  }
+
+  template<class ShapeT, class InputT>
+  auto state(const ShapeT& shape, const InputT& input) {
+    return outputFactory_(shape, input);
+  }
+
+  template<class StateT>
+  StateT& output(StateT& state) {
+    return state;
+  }
+
+  template<class InputT, class StateT>
+  void run(const InputT& input, int begin, int end, StateT& state) {
+    if constexpr(is_range_body<Body>::value) {
+      body_.f_(input, begin, end, state);
+    } else {
+      for(int i = begin; i < end; ++i) {
+        body_(input, i, state);
+      }
+    }
+  }
+
+  Body body_;
+  ShapeFactory shapeFactory_;
+  OutputFactory outputFactory_;
+};
+
+template<class Body, class ShapeFactory, class OutputFactory>
+ElementwiseStage<std::decay_t<Body>, std::decay_t<ShapeFactory>, std::decay_t<OutputFactory>> elementwise(
+    Body&& body, ShapeFactory&& shapeFactory, OutputFactory&& outputFactory) {
+  return {std::forward<Body>(body), std::forward<ShapeFactory>(shapeFactory), std::forward<OutputFactory>(outputFactory)};
+}
+
+// Two element-wise stages where second reads the output of first. Both outputs are
+// allocated up front and each block is run through first and then second a chunk
+// at a time, so second reads what first wrote while it is still in cache.
+template<class First, class Second>
+struct FusedStage {
+  static constexpr int chunk = 1024;
+
+  template<class InputT>
+  auto shape(const InputT& input) {
+    return first_.shape(input);
+  }
+
+  template<class ShapeT, class InputT>
+  auto state(const ShapeT& shape, const InputT& input) {
+    auto firstState = first_.state(shape, input);
+    const auto& firstOutput = first_.output(firstState);
+    if(second_.shape(firstOutput) != shape) {
+      throw std::logic_error("Fused bulk stages must have the same shape");
+    }
+    auto secondState = second_.state(shape, firstOutput);
+    return std::make_pair(std::move(firstState), std::move(secondState));
+  }
+
+  template<class StateT>
+  auto& output(StateT& state) {
+    return second_.output(state.second);
+  }
+
+  template<class InputT, class StateT>
+  void run(const InputT& input, int begin, int end, StateT& state) {
+    for(int chunkBegin = begin; chunkBegin < end; chunkBegin += chunk) {
+      const int chunkEnd = std::min(chunkBegin + chunk, end);
+      first_.run(input, chunkBegin, chunkEnd, state.first);
+      second_.run(first_.output(state.first), chunkBegin, chunkEnd, state.second);
+    }
+  }
+
+  First first_;
+  Second second_;
+};
+
+template<class First, class Second>
+FusedStage<std::decay_t<First>, std::decay_t<Second>> fuse(First&& first, Second&& second) {
+  return {std::forward<First>(first), std::forward<Second>(second)};
+}
+
+// Element-wise stage that maps each element of a vector, out[i] = f(in[i]). Fusing
+// two map stages composes their functions, so no intermediate vector is written.
+template<class F>
+struct MapStage {
+  template<class InputT>
+  int shape(const InputT& input) {
+    return static_cast<int>(input.size());
+  }
+
+  template<class InputT>
+  auto state(const int& shape, const InputT& /*input*/) {
+    return std::vector<std::invoke_result_t<F&, const typename InputT::value_type&>>(shape);
+  }
+
+  template<class StateT>
+  StateT& output(StateT& state) {
+    return state;
+  }
+
+  template<class InputT, class StateT>
+  void run(const InputT& input, int begin, int end, StateT& state) {
+    for(int i = begin; i < end; ++i) {
+      state[i] = f_(input[i]);
+    }
+  }
+
+  F f_;
+};
+
+template<class F>
+MapStage<std::decay_t<F>> map_stage(F&& f) {
+  return {std::forward<F>(f)};
+}
+
+template<class F, class G>
+struct ComposedMap {
+  template<class T>
+  auto operator()(const T& value) {
+    return g_(f_(value));
+  }
+
+  F f_;
+  G g_;
+};
+
+template<class F, class G>
+MapStage<ComposedMap<F, G>> fuse(MapStage<F> first, MapStage<G> second) {
+  return {{std::move(first.f_), std::move(second.f_)}};
+}
+
+// Bulk continuation running an element-wise or fused stage over an int shape in one
+// sweep, producing the output of its last stage
+template<class Stage>
+auto bulk_then_value(Stage stage) {
+  return bulk_then_value(
+    range_body([stage](const auto& input, int begin, int end, auto& state) mutable {
+      stage.run(input, begin, end, state);
+    }),
+    [stage](const auto& input) mutable {
+      return stage.shape(input);
+    },
+    [stage](const auto& shape, const auto& input) mutable {
+      return stage.state(shape, input);
+    },
+    [stage](auto&& state, auto& outputPromise) mutable {
+      outputPromise.set_value(std::move(stage.output(state)));
+    });
+}
+
+// Output of a bulk continuation, written into storage owned by the executor
+template<class T>
+class OutputPromise {
+public:
+    OutputPromise(
+      std::optional<T>& resultStorage,
+      std::optional<std::exception_ptr>& exceptionStorage)
+      : resultStorage_(resultStorage), exceptionStorage_(exceptionStorage) {}
+
+    void set_value(T&& value) {
+        resultStorage_.emplace(std::move(value));
+    }
+
+    void set_value(const T& value) {
+        resultStorage_.emplace(value);
+    }
+
+    void set_exception(std::exception_ptr e) {
+        exceptionStorage_ = std::move(e);
+    }
+
+private:
+    std::optional<T>& resultStorage_;
+    std::optional<std::exception_ptr>& exceptionStorage_;
+};
+
+// A bulk continuation bound once to its output storage, input promise and driver,
+// to be run many times. Each run reuses the promise, the driver and, through a
+// resettable shared factory, the shared states, so with an int shape and states
+// reset in place a run allocates nothing in the plan itself.
+// The driver refers to the promise, so a plan never moves.
+template<class InputT, class OutputT, class Continuation, class Driver>
+class BulkPlan {
+public:
+  BulkPlan(Continuation&& cont, Driver driver) :
+    promise_{std::move(cont)(OutputPromise<OutputT>{result_, exception_})(std::move(driver), input_type<InputT>{})},
+    driver_{promise_.bulk_driver()} {}
+
+  BulkPlan(const BulkPlan&) = delete;
+  BulkPlan& operator=(const BulkPlan&) = delete;
+
+  // Run the plan on input, blocking until done has run
+  TrivialFuture<OutputT> execute(TrivialFuture<InputT> inputFuture) {
+    result_.reset();
+    exception_.reset();
+    promise_.set_value(std::move(inputFuture).get());
+    driver_.start();
+    driver_.end();
+    if(exception_) {
+      std::rethrow_exception(*exception_);
+    }
+    return TrivialFuture<OutputT>{std::move(*result_)};
+  }
+
+private:
+  using PromiseT = std::invoke_result_t<
+    std::invoke_result_t<Continuation, OutputPromise<OutputT>>, Driver, input_type<InputT>>;
+  using DriverT = decltype(std::declval<PromiseT&>().bulk_driver());
+
+  std::optional<OutputT> result_;
+  std::optional<std::exception_ptr> exception_;
+  PromiseT promise_;
+  DriverT driver_;
+};
+
+// A bulk continuation run over an input that arrives as a sequence of chunks. Each
+// pushed chunk is queued for one of a few lanes, each a promise and driver of its
+// own run by a thread of the stream's, so up to lanes chunks are in flight at once
+// and a chunk is dispatched as it arrives while the ones before it still run. The
+// shape is taken from each chunk, and each lane makes its states from the first
+// chunk it takes and carries them across the rest. finish merges the states of
+// every lane with combineStates and runs the result selector, so done fires once
+// after the final chunk. A single shared state cannot be split across lanes, so
+// unless the shared factory is privatized the stream runs one chunk at a time.
+// A stop or an exception in one chunk skips the chunks not yet started.
+// The drivers refer to their promises, so a stream never moves.
+template<class ChunkT, class OutputT, class Continuation, class Driver>
+class BulkStream {
+public:
+  BulkStream(const Continuation& cont, const Driver& driver, std::size_t lanes) {
+    const std::size_t count = PromiseT::mergeable_states ? std::max<std::size_t>(lanes, 1) : 1;
+    for(std::size_t i = 0; i < count; ++i) {
+      lanes_.push_back(std::make_unique<Lane>(cont, driver));
+    }
+    for(auto& lane : lanes_) {
+      threads_.emplace_back([this, lane = lane.get()](){ run(*lane); });
+    }
+  }
+
+  BulkStream(const BulkStream&) = delete;
+  BulkStream& operator=(const BulkStream&) = delete;
+
+  ~BulkStream() {
+    close();
+  }
+
+  // Queue a chunk, to run on the next lane that is free
+  void push(ChunkT chunk) {
+    {
+      std::lock_guard<std::mutex> lock{lock_};
+      if(closed_) {
+        throw std::logic_error("BulkStream::push after finish");
+      }
+      chunks_.push_back(std::move(chunk));
+      ++pushed_;
+    }
+    cv_.notify_one();
+  }
+
+  // Run the chunks still queued and complete the output, blocking until done has run
+  TrivialFuture<OutputT> finish() {
+    {
+      std::lock_guard<std::mutex> lock{lock_};
+      if(closed_) {
+        throw std::logic_error("BulkStream::finish called twice");
+      }
+      if(pushed_ == 0) {
+        throw std::logic_error("BulkStream::finish with no chunks pushed");
+      }
+      closed_ = true;
+    }
+    close();
+    // The first chunk always runs, so some lane has states to merge into
+    Lane* target = nullptr;
+    for(auto& lane : lanes_) {
+      if(lane->chunks_ == 0) {
+        continue;
+      }
+      if(!target) {
+        target = lane.get();
+      } else if constexpr(PromiseT::mergeable_states) {
+        target->promise_.merge_stream(lane->promise_);
+      }
+    }
+    target->promise_.finish_stream();
+    if(target->exception_) {
+      std::rethrow_exception(*target->exception_);
+    }
+    return TrivialFuture<OutputT>{std::move(*target->result_)};
+  }
+
+private:
+  using PromiseT = std::invoke_result_t<
+    std::invoke_result_t<Continuation, OutputPromise<OutputT>>, Driver, input_type<ChunkT>>;
+  using DriverT = decltype(std::declval<PromiseT&>().bulk_driver());
+
+  struct Lane {
+    Lane(Continuation cont, Driver driver) :
+      promise_{std::move(cont)(OutputPromise<OutputT>{result_, exception_})(std::move(driver), input_type<ChunkT>{})},
+      driver_{promise_.bulk_driver()} {}
+
+    std::optional<OutputT> result_;
+    std::optional<std::exception_ptr> exception_;
+    PromiseT promise_;
+    DriverT driver_;
+    std::size_t chunks_ = 0;
+  };
+
+  // Let the lanes run what is queued and wait for them
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock{lock_};
+      closed_ = true;
+    }
+    cv_.notify_all();
+    for(auto& thread : threads_) {
+      if(thread.joinable()) {
+        thread.join();
+      }
+    }
+  }
+
+  void run(Lane& lane) {
+    for(;;) {
+      std::optional<ChunkT> chunk;
+      {
+        std::unique_lock<std::mutex> lock{lock_};
+        cv_.wait(lock, [this](){ return closed_ || !chunks_.empty(); });
+        if(chunks_.empty()) {
+          return;
+        }
+        chunk.emplace(std::move(chunks_.front()));
+        chunks_.pop_front();
+      }
+      if(stopped_.load(std::memory_order_relaxed)) {
+        continue;
+      }
+      ++lane.chunks_;
+      try {
+        lane.promise_.stream_value(std::move(*chunk));
+        lane.driver_.start();
+        lane.driver_.end();
+      } catch(...) {
+        // The shape of a chunk is made outside the driver, so its failure is the
+        // stream's to carry
+        lane.promise_.set_exception(std::current_exception());
+      }
+      if(lane.promise_.stopped()) {
+        stopped_.store(true, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<Lane>> lanes_;
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::deque<ChunkT> chunks_;
+  bool closed_ = false;
+  std::size_t pushed_ = 0;
+  std::atomic<bool> stopped_{false};
+  std::vector<std::thread> threads_;
+};
+
+// Executor that runs bulk continuations with a driver of its choosing. The driver
+// factory is bound into the continuation, so the same continuation can run serially
+// with EndDriver or across a pool with ParallelDriver.
+// The output type is the input type unless given, then_execute<OutputT>(...).
+template<class Driver>
+struct DriverExecutor {
+template<class OutputT = void, class Continuation, class InputT>
+auto then_execute(Continuation&& cont, TrivialFuture<InputT> inputFuture) {
+  using ResultT = std::conditional_t<std::is_void_v<OutputT>, InputT, OutputT>;
+  std::optional<ResultT> resultStorage;
+  std::optional<std::exception_ptr> exceptionStorage;
+  auto boundCont = std::forward<Continuation>(cont)(
+    OutputPromise<ResultT>{resultStorage, exceptionStorage})(Driver(driver_), input_type<InputT>{});
+
+  auto driver = boundCont.bulk_driver();
+  boundCont.set_value(std::move(inputFuture).get());
+  driver.start();
+  driver.end();
+  if(exceptionStorage) {
+    std::rethrow_exception(*exceptionStorage);
+  }
+  return TrivialFuture<ResultT>{std::move(*resultStorage)};
+}
+
+// Bind cont once for inputs of InputT, to run many times with BulkPlan::execute
+template<class InputT, class OutputT = InputT, class Continuation>
+BulkPlan<InputT, OutputT, std::decay_t<Continuation>, Driver> compile(Continuation cont) {
+  return {std::move(cont), driver_};
+}
+
+// Bind cont for inputs that arrive as chunks of ChunkT, to push to a BulkStream
+// with up to lanes chunks in flight
+template<class ChunkT, class OutputT = ChunkT, class Continuation>
+BulkStream<ChunkT, OutputT, std::decay_t<Continuation>, Driver> stream(Continuation cont, std::size_t lanes = 2) {
+  return {cont, driver_, lanes};
+}
+
+Driver driver_;
+};
+
+// Simple class to allow us to return an atomic from the shared factory
+template<class T>
+struct atomic_move_wrapper {
+  template<class RHST>
+  atomic_move_wrapper(RHST&& rhs) : val{std::forward<RHST>(rhs)} {}
+  atomic_move_wrapper(atomic_move_wrapper&& rhs) :
+    val{rhs.val.load()}{
+  }
+  std::atomic<T>& operator*(){return val;}
+  std::atomic<T> val;
+};
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <vector>
+
+#include "bulk_model.h"
+
+// A large array that counts its copies, so we can see that no stage copies it
+struct Samples {
+  Samples() = default;
+  explicit Samples(std::size_t size) : data_(size) {}
+  Samples(Samples&&) = default;
+  Samples& operator=(Samples&&) = default;
+  Samples(const Samples& rhs) : data_{rhs.data_} {
+    ++copies;
+  }
+  Samples& operator=(const Samples& rhs) {
+    data_ = rhs.data_;
+    ++copies;
+    return *this;
+  }
+
+  std::vector<float> data_;
+  static int copies;
+};
+
+int Samples::copies = 0;
+
+int main() {
+  constexpr int size = 1 << 22;
+  ThreadPool pool{default_pool_size(1)};
+  DriverExecutor<ParallelDriver> executor{ParallelDriver{pool}};
+
+  Samples input(size);
+  for(int i = 0; i < size; ++i) {
+    input.data_[i] = float(i % 100) / 100.0f;
+  }
+
+  // Samples -> Samples: square every element into a new array built by the shared
+  // factory and moved out by the result selector
+  auto square = bulk_then_value(
+      range_body([](const Samples& input, int begin, int end, Samples& shared){
+        for(int i = begin; i < end; ++i) {
+          shared.data_[i] = input.data_[i] * input.data_[i];
+        }
+      }),
+      [](const Samples& input){return static_cast<int>(input.data_.size());},
+      [](const int& shape, const Samples& /*input value*/){return Samples(shape);},
+      [](Samples&& shared, auto& outputPromise) {
+        outputPromise.set_value(std::move(shared));
+      });
+
+  // Samples -> double: sum with one partial per worker
+  auto sum = bulk_then_value(
+      range_body([](const Samples& input, int begin, int end, double& shared){
+        for(int i = begin; i < end; ++i) {
+          shared += input.data_[i];
+        }
+      }),
+      [](const Samples& input){return static_cast<int>(input.data_.size());},
+      privatized(
+        [](const int& /*shape*/, const Samples& /*input value*/){return 0.0;},
+        [](double lhs, double rhs){return lhs + rhs;}),
+      [](double&& shared, auto& outputPromise) {
+        outputPromise.set_value(shared);
+      });
+
+  double total = 0;
+  const double ms = time_per_run([&](){
+    auto squared = executor.then_execute(square, TrivialFuture<Samples>{std::move(input)});
+    total = std::move(executor.then_execute<double>(sum, std::move(squared))).get();
+  });
+
+  const int stageCopies = Samples::copies;
+  Samples source(size);
+  const double copyMs = time_per_run([&](){
+    Samples copy{source};
+  });
+
+  std::cout << "Two stages over " << size << " floats: sum of squares " << total << " in "
+            << ms << "ms\n"
+            << "  copies of the input: " << stageCopies << "\n"
+            << "  one copy of the input would cost "
+            << copyMs << "ms per stage\n";
+
+  return 0;
+}
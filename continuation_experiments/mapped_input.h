@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bulk_model.h"
+
+// Bulk input that maps a set of files read-only instead of reading them into a
+// buffer, so a body reads the page cache directly with no user-space copy. Each file
+// is cut into chunks of a whole number of pages, and a chunk never spans two files.
+// The chunks are the units of work, so the shape is chunk_count().
+// Records that cross a chunk boundary are the body's concern.
+
+// One chunk of a mapped file
+struct MappedChunk {
+  const char* data_;
+  std::size_t size_;
+  std::size_t file_;
+  std::size_t offset_;
+};
+
+class MappedFiles {
+public:
+  MappedFiles(const std::vector<std::string>& paths, std::size_t chunkBytes = std::size_t{1} << 22) {
+    const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    chunkBytes_ = std::max(page, (chunkBytes + page - 1) / page * page);
+    try {
+      for(const auto& path : paths) {
+        map(path);
+      }
+    } catch(...) {
+      unmap();
+      throw;
+    }
+  }
+
+  MappedFiles(MappedFiles&& rhs) noexcept :
+    files_{std::move(rhs.files_)}, chunks_{std::move(rhs.chunks_)}, chunkBytes_{rhs.chunkBytes_} {
+    rhs.files_.clear();
+    rhs.chunks_.clear();
+  }
+
+  MappedFiles(const MappedFiles&) = delete;
+  MappedFiles& operator=(const MappedFiles&) = delete;
+  MappedFiles& operator=(MappedFiles&&) = delete;
+
+  ~MappedFiles() {
+    unmap();
+  }
+
+  int chunk_count() const {
+    return static_cast<int>(chunks_.size());
+  }
+
+  const MappedChunk& chunk(int c) const {
+    return chunks_[c];
+  }
+
+  // Ask the kernel to start reading chunks [begin, end) ahead of their use
+  void will_need(int begin, int end) const {
+    for(int c = std::max(begin, 0); c < std::min(end, chunk_count()); ++c) {
+      madvise(const_cast<char*>(chunks_[c].data_), chunks_[c].size_, MADV_WILLNEED);
+    }
+  }
+
+private:
+  struct File {
+    int fd_;
+    char* data_;
+    std::size_t size_;
+  };
+
+  void map(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+      throw std::runtime_error("Could not open " + path);
+    }
+    struct stat status;
+    if(fstat(fd, &status) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Could not stat " + path);
+    }
+    const std::size_t size = static_cast<std::size_t>(status.st_size);
+    char* data = nullptr;
+    if(size > 0) {
+      void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(mapped == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Could not map " + path);
+      }
+      data = static_cast<char*>(mapped);
+      // Within a chunk access is sequential, so let the kernel read ahead
+      madvise(data, size, MADV_SEQUENTIAL);
+    }
+    files_.push_back(File{fd, data, size});
+    for(std::size_t offset = 0; offset < size; offset += chunkBytes_) {
+      chunks_.push_back(MappedChunk{data + offset, std::min(chunkBytes_, size - offset), files_.size() - 1, offset});
+    }
+  }
+
+  void unmap() {
+    for(auto& file : files_) {
+      if(file.data_) {
+        munmap(file.data_, file.size_);
+      }
+      ::close(file.fd_);
+    }
+    files_.clear();
+  }
+
+  std::vector<File> files_;
+  std::vector<MappedChunk> chunks_;
+  std::size_t chunkBytes_;
+};
+
+// Range body over the chunks of a MappedFiles, f(chunk, shared) for each chunk. As it
+// advances through its block it hints the next lookahead chunks of the block with
+// MADV_WILLNEED, so the kernel reads them while this chunk is processed.
+// lookahead must be at least 1.
+template<class F>
+auto mapped_body(F f, int lookahead = 4) {
+  if(lookahead < 1) {
+    throw std::logic_error("mapped_body needs a lookahead of at least one chunk");
+  }
+  return range_body([f = std::move(f), lookahead](const MappedFiles& in, int begin, int end, auto& shared) mutable {
+    in.will_need(begin, std::min(begin + lookahead, end));
+    for(int c = begin; c < end; ++c) {
+      if((c - begin) % lookahead == 0) {
+        in.will_need(c + lookahead, std::min(c + 2 * lookahead, end));
+      }
+      f(in.chunk(c), shared);
+    }
+  });
+}
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mapped_input.h"
+
+// Checksum of a file: the sum of its bytes and the number of lines
+struct Sum {
+  std::uint64_t bytes_;
+  std::uint64_t lines_;
+};
+
+Sum sum(const char* data, std::size_t size) {
+  Sum s{0, 0};
+  for(std::size_t i = 0; i < size; ++i) {
+    const unsigned char c = static_cast<unsigned char>(data[i]);
+    s.bytes_ += c;
+    s.lines_ += c == '\n';
+  }
+  return s;
+}
+
+// The file read into memory in one buffer, cut into blocks of blockSize bytes
+struct Buffer {
+  std::vector<char> data_;
+  std::size_t blockSize_;
+};
+
+// Write size bytes of text lines to path
+void write_file(const std::string& path, std::size_t size) {
+  std::string block;
+  for(int line = 0; block.size() < (1 << 20); ++line) {
+    block += "line " + std::to_string(line * 7919 % 100000) + " of some text to sum\n";
+  }
+  const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if(fd < 0) {
+    throw std::runtime_error("Could not create " + path);
+  }
+  for(std::size_t written = 0; written < size;) {
+    const ssize_t n = ::write(fd, block.data(), std::min(block.size(), size - written));
+    if(n <= 0) {
+      ::close(fd);
+      throw std::runtime_error("Could not write " + path);
+    }
+    written += static_cast<std::size_t>(n);
+  }
+  fsync(fd);
+  ::close(fd);
+}
+
+// Directory of its own under the system temporary directory, removed with the files
+// in it when the run ends, however it ends
+class TempDir {
+public:
+  TempDir() {
+    std::string pattern = (std::filesystem::temp_directory_path() / "mmap_bulk.XXXXXX").string();
+    if(!mkdtemp(pattern.data())) {
+      throw std::runtime_error("Could not create a directory from " + pattern);
+    }
+    path_ = pattern;
+  }
+
+  TempDir(const TempDir&) = delete;
+  TempDir& operator=(const TempDir&) = delete;
+
+  ~TempDir() {
+    std::error_code ignored;
+    std::filesystem::remove_all(path_, ignored);
+  }
+
+  std::string file(const std::string& name) const {
+    return (path_ / name).string();
+  }
+
+private:
+  std::filesystem::path path_;
+};
+
+// Drop the file from the page cache so that the next run reads it from disk
+void evict(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    throw std::runtime_error("Could not open " + path);
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  ::close(fd);
+}
+
+Buffer read_file(const std::string& path, std::size_t blockSize) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    throw std::runtime_error("Could not open " + path);
+  }
+  Buffer buffer{std::vector<char>(static_cast<std::size_t>(lseek(fd, 0, SEEK_END))), blockSize};
+  for(std::size_t done = 0; done < buffer.data_.size();) {
+    const ssize_t n = pread(fd, buffer.data_.data() + done, buffer.data_.size() - done, static_cast<off_t>(done));
+    if(n <= 0) {
+      ::close(fd);
+      throw std::runtime_error("Could not read " + path);
+    }
+    done += static_cast<std::size_t>(n);
+  }
+  ::close(fd);
+  return buffer;
+}
+
+int main(int argc, char* argv[]) {
+  // File size in MiB. Multi-GB files are the real use, but the buffer has to fit in
+  // memory next to the page cache and the file is written on every run, so the
+  // default is small. The files go to a temporary directory that is removed on exit.
+  const std::size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+  const std::size_t chunkBytes = std::size_t{1} << 22;
+  const TempDir directory;
+  const std::string path = directory.file("mmap_bulk.data");
+  ThreadPool pool{default_pool_size(1)};
+  DriverExecutor<ParallelDriver> executor{ParallelDriver{pool}};
+
+  auto combine = [](Sum lhs, Sum rhs){return Sum{lhs.bytes_ + rhs.bytes_, lhs.lines_ + rhs.lines_};};
+  auto result = [](Sum&& shared, auto& outputPromise) {
+    outputPromise.set_value(std::move(shared));
+  };
+
+  auto mappedSum = bulk_then_value(
+      mapped_body([combine](const MappedChunk& chunk, Sum& shared){
+        shared = combine(shared, sum(chunk.data_, chunk.size_));
+      }),
+      [](const MappedFiles& in){return in.chunk_count();},
+      privatized([](const int& /*shape*/, const MappedFiles& /*input*/){return Sum{0, 0};}, combine),
+      result);
+
+  auto bufferSum = bulk_then_value(
+      range_body([combine](const Buffer& in, int begin, int end, Sum& shared){
+        const std::size_t first = static_cast<std::size_t>(begin) * in.blockSize_;
+        const std::size_t last = std::min(static_cast<std::size_t>(end) * in.blockSize_, in.data_.size());
+        shared = combine(shared, sum(in.data_.data() + first, last - first));
+      }),
+      [](const Buffer& in){return static_cast<int>((in.data_.size() + in.blockSize_ - 1) / in.blockSize_);},
+      privatized([](const int& /*shape*/, const Buffer& /*input*/){return Sum{0, 0};}, combine),
+      result);
+
+  write_file(path, megabytes << 20);
+
+  auto mapped = [&](){
+    return std::move(executor.then_execute<Sum>(
+      mappedSum, TrivialFuture<MappedFiles>{MappedFiles{{path}, chunkBytes}})).get();
+  };
+  auto buffered = [&](){
+    return std::move(executor.then_execute<Sum>(bufferSum, TrivialFuture<Buffer>{read_file(path, chunkBytes)})).get();
+  };
+  auto report = [&](const char* name, bool cold, auto run) {
+    if(cold) {
+      evict(path);
+    }
+    Sum s{0, 0};
+    const double seconds = time_per_run<std::chrono::duration<double>>([&](){
+      s = run();
+    });
+    std::cout << "  " << name << ": " << seconds * 1000.0 << "ms, " << megabytes / seconds
+              << "MiB/s, sum " << s.bytes_ << " over " << s.lines_ << " lines\n";
+  };
+
+  std::cout << "Sum of a " << megabytes << "MiB file in " << (chunkBytes >> 20) << "MiB chunks with "
+            << pool.size() + 1 << " threads:\n";
+  report("read into a vector, cold cache", true, buffered);
+  report("mapped, cold cache", true, mapped);
+  report("read into a vector, warm cache", false, buffered);
+  report("mapped, warm cache", false, mapped);
+
+  {
+    // Several files map as one input, each cut into its own chunks
+    const std::string second = directory.file("mmap_bulk.data.2");
+    write_file(second, (std::size_t{1} << 20) + 123);
+    auto both = std::move(executor.then_execute<Sum>(
+      mappedSum, TrivialFuture<MappedFiles>{MappedFiles{{path, second}, chunkBytes}})).get();
+    auto first = mapped();
+    auto rest = sum(read_file(second, chunkBytes).data_.data(), (std::size_t{1} << 20) + 123);
+    std::cout << "Two files: sums match " << (both.bytes_ == first.bytes_ + rest.bytes_) << "\n";
+  }
+
+  {
+    bool rejected = false;
+    try {
+      mapped_body([](const MappedChunk&, Sum&){}, 0);
+    } catch(const std::logic_error&) {
+      rejected = true;
+    }
+    std::cout << "Lookahead of zero rejected: " << rejected << "\n";
+  }
+
+  return 0;
+}
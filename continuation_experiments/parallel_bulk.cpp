@@ -0,0 +1,85 @@
+#include <cmath>
+#include <iostream>
+
+#include "bulk_model.h"
+
+using InputT = int;
+using ShapeT = int;
+using ShapeElementT = int;
+using SharedStateT = atomic_move_wrapper<int>;
+
+// CPU-bound body whose cost per index is fixed, so any speedup comes from the driver
+int work(int input, int idx) {
+  double x = input + idx;
+  for(int i = 0; i < 2000; ++i) {
+    x = std::sin(x) + 1.0;
+  }
+  return x > 0 ? 1 : 0;
+}
+
+int main() {
+  // The calling thread runs a block too so leave it a core
+  ThreadPool pool{default_pool_size(1)};
+
+  auto continuation = bulk_then_value(
+      [](const InputT& input, ShapeElementT /*idx*/, SharedStateT &shared){*shared+=input;}, // Operation
+      [](const InputT& /*input value*/){return int{20};}, // Shape factory.
+      [](const ShapeT& /*shape*/, const InputT& /*input value*/) -> SharedStateT {return {0};}, // Shared factory
+      [](SharedStateT&& shared, auto& outputPromise) {  // Result selector/output
+        outputPromise.set_value(std::move(*shared));
+      });
+
+  {
+    auto resultF = DriverExecutor<EndDriver>{}.then_execute(continuation, TrivialFuture<int>{2});
+    std::cout << "EndDriver: " << std::move(resultF).get() << "\n";
+  }
+  {
+    auto resultF = DriverExecutor<ParallelDriver>{ParallelDriver{pool}}.then_execute(
+      continuation, TrivialFuture<int>{2});
+    std::cout << "ParallelDriver: " << std::move(resultF).get() << "\n";
+  }
+
+  {
+    // done must run once, after every index, whatever the shape
+    int doneCount = 0;
+    auto counting = bulk_then_value(
+        [](const InputT& input, ShapeElementT /*idx*/, SharedStateT &shared){*shared+=input;},
+        [](const InputT& input){return input;},
+        [](const ShapeT& /*shape*/, const InputT& /*input value*/) -> SharedStateT {return {0};},
+        [&doneCount](SharedStateT&& shared, auto& outputPromise) {
+          ++doneCount;
+          outputPromise.set_value(std::move(*shared));
+        });
+    bool correct = true;
+    for(int shape : {0, 1, 3, 1000}) {
+      auto resultF = DriverExecutor<ParallelDriver>{ParallelDriver{pool}}.then_execute(
+        counting, TrivialFuture<int>{shape});
+      correct = correct && std::move(resultF).get() == shape * shape;
+    }
+    std::cout << "Results correct: " << correct << ", done calls: " << doneCount << "\n";
+  }
+
+  {
+    auto cpuBound = bulk_then_value(
+        [](const InputT& input, ShapeElementT idx, SharedStateT &shared){*shared+=work(input, idx);},
+        [](const InputT& /*input value*/){return int{20000};},
+        [](const ShapeT& /*shape*/, const InputT& /*input value*/) -> SharedStateT {return {0};},
+        [](SharedStateT&& shared, auto& outputPromise) {
+          outputPromise.set_value(std::move(*shared));
+        });
+    int serialResult = 0;
+    int parallelResult = 0;
+    auto serial = time_per_run([&](){
+      serialResult = std::move(DriverExecutor<EndDriver>{}.then_execute(cpuBound, TrivialFuture<int>{2})).get();
+    });
+    auto parallel = time_per_run([&](){
+      parallelResult = std::move(
+        DriverExecutor<ParallelDriver>{ParallelDriver{pool}}.then_execute(cpuBound, TrivialFuture<int>{2})).get();
+    });
+    std::cout << "CPU-bound body over 20000 indices with " << pool.size() + 1 << " threads: serial "
+              << serial << "ms, parallel " << parallel << "ms, speedup " << serial / parallel
+              << " (results " << serialResult << ", " << parallelResult << ")\n";
+  }
+
+  return 0;
+}
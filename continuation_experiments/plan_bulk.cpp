@@ -0,0 +1,130 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "bulk_model.h"
+
+// Count every allocation, so that we can see what a run allocates.
+// g++ takes the replaced delete freeing memory from the replaced new as a mismatch.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+std::atomic<long> allocations{0};
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if(void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  operator delete(p);
+}
+
+// Shared states are padded to a cache line, so their slots use aligned new
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  ++allocations;
+  const std::size_t align = static_cast<std::size_t>(alignment);
+  if(void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+struct View {
+  const int* data_;
+  int size_;
+};
+
+using Histogram = std::vector<int>;
+constexpr int bins = 64;
+
+int main() {
+  constexpr int size = 4096;
+  constexpr int runs = 20000;
+  ThreadPool pool{default_pool_size(1)};
+  DriverExecutor<ParallelDriver> executor{ParallelDriver{pool}};
+
+  std::vector<int> values(size);
+  for(int i = 0; i < size; ++i) {
+    values[i] = (i * 7919) % 1000;
+  }
+  const View input{values.data(), size};
+
+  auto body = range_body([](const View& in, int begin, int end, Histogram& shared){
+    for(int i = begin; i < end; ++i) {
+      ++shared[in.data_[i] % bins];
+    }
+  });
+  auto shape = [](const View& in){return in.size_;};
+  auto empty = [](const int& /*shape*/, const View& /*input*/){return Histogram(bins);};
+  auto combine = [](Histogram lhs, Histogram rhs){
+    for(int b = 0; b < bins; ++b) {
+      lhs[b] += rhs[b];
+    }
+    return lhs;
+  };
+  // The result is the fullest bin, so the histogram itself is not handed out
+  auto fullest = [](Histogram&& shared, auto& outputPromise) {
+    int most = 0;
+    for(int count : shared) {
+      most = std::max(most, count);
+    }
+    outputPromise.set_value(most);
+  };
+
+  auto fresh = bulk_then_value(body, shape, privatized(empty, combine), fullest);
+  auto reused = bulk_then_value(
+      body, shape,
+      privatized(
+        resettable(empty, [](Histogram& state, const int& /*shape*/, const View& /*input*/){
+          std::fill(state.begin(), state.end(), 0);
+        }),
+        // Adds into the left state in place, so combining allocates nothing either
+        [](Histogram&& lhs, Histogram&& rhs){
+          for(int b = 0; b < bins; ++b) {
+            lhs[b] += rhs[b];
+          }
+          return std::move(lhs);
+        }),
+      fullest);
+
+  auto report = [&](const char* name, auto run) {
+    int result = run();
+    const long before = allocations;
+    const double us = time_per_run<std::chrono::duration<double, std::micro>>([&](){
+      result = run();
+    }, runs);
+    std::cout << "  " << name << ": " << us
+              << "us and " << double(allocations - before) / runs << " allocations per run, fullest bin "
+              << result << "\n";
+  };
+
+  std::cout << "Histogram of " << size << " ints into " << bins << " bins with "
+            << pool.size() + 1 << " threads:\n";
+  report("then_execute each run", [&](){
+    return std::move(executor.then_execute<int>(fresh, TrivialFuture<View>{input})).get();
+  });
+  auto rebuilding = executor.compile<View, int>(fresh);
+  report("plan, states rebuilt", [&](){
+    return std::move(rebuilding.execute(TrivialFuture<View>{input})).get();
+  });
+  auto resetting = executor.compile<View, int>(reused);
+  report("plan, states reset in place", [&](){
+    return std::move(resetting.execute(TrivialFuture<View>{input})).get();
+  });
+
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <vector>
+
+#include "bulk_model.h"
+
+using InputT = int;
+using ShapeT = int;
+using ShapeElementT = int;
+
+int main() {
+  constexpr int size = 1 << 20;
+  constexpr int repetitions = 20;
+  ThreadPool pool{default_pool_size(1)};
+  using Parallel = DriverExecutor<ParallelDriver>;
+  auto msPerCount = [&](auto& count){
+    return time_per_run([&](){
+      std::move(Parallel{ParallelDriver{pool}}.then_execute(count, TrivialFuture<int>{1})).get();
+    }, repetitions);
+  };
+
+  std::vector<float> values(size);
+  for(int i = 0; i < size; ++i) {
+    values[i] = 1.0f / float(i + 1);
+  }
+  const float* data = values.data();
+
+  // Every index updates one atomic counter, so all threads contend on one line
+  auto atomicCount = bulk_then_value(
+      [](const InputT& input, ShapeElementT /*idx*/, atomic_move_wrapper<int>& shared){*shared += input;},
+      [](const InputT& /*input value*/){return size;},
+      [](const ShapeT& /*shape*/, const InputT& /*input value*/) -> atomic_move_wrapper<int> {return {0};},
+      [](atomic_move_wrapper<int>&& shared, auto& outputPromise) {
+        outputPromise.set_value(std::move(*shared));
+      });
+
+  // Each block counts into its own slot and the slots are summed once in done
+  auto privatizedCount = bulk_then_value(
+      [](const InputT& input, ShapeElementT /*idx*/, int& shared){shared += input;},
+      [](const InputT& /*input value*/){return size;},
+      privatized(
+        [](const ShapeT& /*shape*/, const InputT& /*input value*/) {return int{0};},
+        [](int lhs, int rhs) {return lhs + rhs;}),
+      [](int&& shared, auto& outputPromise) {
+        outputPromise.set_value(shared);
+      });
+
+  std::cout << "Count of " << size << " indices with " << pool.size() + 1 << " threads:\n"
+            << "  atomic shared state: " << std::move(Parallel{ParallelDriver{pool}}.then_execute(
+                 atomicCount, TrivialFuture<int>{1})).get()
+            << " in " << msPerCount(atomicCount) << "ms\n"
+            << "  privatized state: " << std::move(Parallel{ParallelDriver{pool}}.then_execute(
+                 privatizedCount, TrivialFuture<int>{1})).get()
+            << " in " << msPerCount(privatizedCount) << "ms\n";
+
+  // A float sum depends on the order of additions. Blocks are fixed and partials are
+  // merged in a fixed tree, so the parallel sum is identical on every run.
+  auto floatSum = bulk_then_value(
+      range_body([data](const InputT& /*input*/, ShapeElementT begin, ShapeElementT end, float& shared){
+        for(ShapeElementT i = begin; i < end; ++i) {
+          shared += data[i];
+        }
+      }),
+      [](const InputT& /*input value*/){return size;},
+      privatized(
+        [](const ShapeT& /*shape*/, const InputT& /*input value*/) {return 0.0f;},
+        [](float lhs, float rhs) {return lhs + rhs;}),
+      [](float&& shared, auto& outputPromise) {
+        // The output is integral, so report the sum in millionths
+        outputPromise.set_value(static_cast<int>(shared * 1e6f));
+      });
+
+  std::vector<int> sums;
+  for(int r = 0; r < 10; ++r) {
+    sums.push_back(std::move(Parallel{ParallelDriver{pool}}.then_execute(floatSum, TrivialFuture<int>{0})).get());
+  }
+  bool deterministic = true;
+  for(int sum : sums) {
+    deterministic = deterministic && sum == sums[0];
+  }
+  int serialSum = std::move(DriverExecutor<EndDriver>{}.then_execute(floatSum, TrivialFuture<int>{0})).get();
+  std::cout << "Float harmonic sum, millionths: " << sums[0] << " parallel, " << serialSum
+            << " serial, identical across runs: " << deterministic << "\n";
+
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "bulk_model.h"
+
+using InputT = int;
+using ShapeT = int;
+using ShapeElementT = int;
+using SharedStateT = int;
+
+// The protocol before ranges: the driver makes one call per index
+template<class PromiseT, class ShapeF, class AtF, class DoneF>
+struct PerIndexDriverImpl {
+  void start() {
+  }
+
+  void end() {
+    const auto& shape = shapeF_();
+    for(std::decay_t<decltype(shape)> i = 0; i < shape; ++i) {
+      atF_(i);
+    }
+    doneF_();
+  }
+
+  PromiseT& promise_;
+  ShapeF shapeF_;
+  AtF atF_;
+  DoneF doneF_;
+};
+
+struct PerIndexDriver {
+  template<class PromiseT, class ShapeF, class AtF, class DoneF>
+  auto operator()(PromiseT& prom, ShapeF&& shapeF, AtF&& atF, DoneF&& doneF){
+    return PerIndexDriverImpl<PromiseT, ShapeF, AtF, DoneF>{
+      prom,
+      std::forward<ShapeF>(shapeF),
+      std::forward<AtF>(atF),
+      std::forward<DoneF>(doneF)};
+  }
+};
+
+// A driver behind an ABI boundary, such as a runtime's work queue, sees the body only
+// through a type-erased call, so the per-index protocol pays one indirect call per
+// index and the compiler cannot vectorize across them. The range protocol pays one
+// per block.
+template<bool ranges>
+struct ErasedDriver {
+  template<class PromiseT, class ShapeF, class AtF, class DoneF>
+  auto operator()(PromiseT& prom, ShapeF&& shapeF, AtF&& atF, DoneF&& doneF){
+    (void)prom;
+    return Impl{std::forward<ShapeF>(shapeF), atF, atF, std::forward<DoneF>(doneF)};
+  }
+
+  struct Impl {
+    void start() {
+    }
+
+    void end() {
+      const int shape = shapeF_();
+      if(ranges) {
+        rangeF_(0, shape);
+      } else {
+        for(int i = 0; i < shape; ++i) {
+          atF_(i);
+        }
+      }
+      doneF_();
+    }
+
+    std::function<int()> shapeF_;
+    std::function<void(int)> atF_;
+    std::function<void(int, int)> rangeF_;
+    std::function<void()> doneF_;
+  };
+};
+
+// Build a SAXPY continuation, y = a * x + y with a taken from the input
+template<class Body>
+auto saxpy(Body body, int size) {
+  return bulk_then_value(
+      std::move(body),
+      [size](const InputT& /*input value*/){return size;},
+      [](const ShapeT& /*shape*/, const InputT& /*input value*/) -> SharedStateT {return 0;},
+      [](SharedStateT&& shared, auto& outputPromise) {
+        outputPromise.set_value(shared);
+      });
+}
+
+int main() {
+  constexpr int size = 1 << 12;
+  constexpr int repetitions = 50000;
+  std::vector<float> xs(size, 1.0f);
+  std::vector<float> ys(size, 0.0f);
+  float* x = xs.data();
+  float* y = ys.data();
+  auto nsPerElement = [&](auto executor, auto& continuation){
+    return time_per_run<std::chrono::duration<double, std::nano>>([&](){
+      std::move(executor.then_execute(continuation, TrivialFuture<int>{2})).get();
+    }, repetitions) / size;
+  };
+
+  auto perIndex = saxpy(
+      [x, y](const InputT& a, ShapeElementT i, SharedStateT& /*shared*/){ y[i] += a * x[i]; }, size);
+  auto range = saxpy(
+      range_body([x, y](const InputT& a, ShapeElementT begin, ShapeElementT end, SharedStateT& /*shared*/){
+        const float* __restrict xr = x;
+        float* __restrict yr = y;
+        for(ShapeElementT i = begin; i < end; ++i) {
+          yr[i] += a * xr[i];
+        }
+      }), size);
+
+  auto oldProtocol = nsPerElement(DriverExecutor<PerIndexDriver>{}, perIndex);
+  auto adapted = nsPerElement(DriverExecutor<EndDriver>{}, perIndex);
+  auto ranged = nsPerElement(DriverExecutor<EndDriver>{}, range);
+  auto erasedPerIndex = nsPerElement(DriverExecutor<ErasedDriver<false>>{}, perIndex);
+  auto erasedRange = nsPerElement(DriverExecutor<ErasedDriver<true>>{}, range);
+
+  ThreadPool pool{default_pool_size(1)};
+  auto parallelRanged = nsPerElement(DriverExecutor<ParallelDriver>{ParallelDriver{pool}}, range);
+
+  std::cout << "SAXPY over " << size << " floats:\n"
+            << "  per-index calls from the driver " << oldProtocol << " ns/element\n"
+            << "  per-index body through the range adapter " << adapted << " ns/element\n"
+            << "  range body " << ranged << " ns/element\n"
+            << "  per-index calls through a type-erased driver " << erasedPerIndex << " ns/element\n"
+            << "  range body through a type-erased driver " << erasedRange << " ns/element\n"
+            << "  range body, parallel driver " << parallelRanged << " ns/element\n"
+            << "y[0] = " << y[0] << " (expected " << 2.0f * 6 * repetitions << ")\n";
+
+  return 0;
+}
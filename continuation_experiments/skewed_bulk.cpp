@@ -0,0 +1,128 @@
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <vector>
+
+#include "bulk_model.h"
+
+using InputT = int;
+using ShapeElementT = int;
+
+constexpr int rows = 4096;
+constexpr int workers = 4;
+
+// Cost of a row in units of work. The last eighth of the rows are 64 times as
+// costly as the rest, like the dense rows of a sparse matrix.
+int cost(int row) {
+  return row >= rows - rows / 8 ? 64 : 1;
+}
+
+// Work done by each worker, so that balance shows even when workers share a core
+std::atomic<long> workDone[workers];
+
+double work(int units) {
+  double x = units;
+  for(int i = 0; i < units * 200; ++i) {
+    x = std::sqrt(x + 1.0);
+  }
+  return x;
+}
+
+int main() {
+  WorkStealingPool pool{workers};
+
+  auto rowsOf = bulk_then_value(
+      [&pool](const InputT& /*input*/, ShapeElementT row, long& shared){
+        const int units = cost(row);
+        // Never true, but keeps the work from being optimized away
+        if(work(units) < 0.0) {
+          ++shared;
+        }
+        shared += units;
+        workDone[pool.worker_index()].fetch_add(units, std::memory_order_relaxed);
+      },
+      [](const InputT& /*input value*/){return rows;},
+      privatized(
+        [](const int& /*shape*/, const InputT& /*input value*/){return long{0};},
+        [](long lhs, long rhs){return lhs + rhs;}),
+      [](long&& shared, auto& outputPromise) {
+        outputPromise.set_value(static_cast<int>(shared));
+      });
+
+  long total = 0;
+  for(int row = 0; row < rows; ++row) {
+    total += cost(row);
+  }
+
+  std::cout << rows << " rows, the last eighth 64 times as costly, on " << workers << " workers:\n";
+  auto measure = [&](const char* name, Schedule schedule, int grain) {
+    for(auto& w : workDone) {
+      w = 0;
+    }
+    int result = 0;
+    const double ms = time_per_run([&](){
+      result = std::move(DriverExecutor<StealingDriver>{StealingDriver{pool, schedule, grain}}.then_execute(
+          rowsOf, TrivialFuture<int>{0})).get();
+    });
+    long most = 0;
+    for(auto& w : workDone) {
+      most = std::max(most, w.load());
+    }
+    std::cout << "  " << name << ": " << ms
+              << "ms, busiest worker does " << double(most) * workers / total
+              << "x its share, correct " << (result == total) << "\n";
+  };
+  measure("static", Schedule::Static, 0);
+  measure("dynamic, adaptive grain", Schedule::Dynamic, 0);
+  measure("dynamic, grain 1", Schedule::Dynamic, 1);
+  measure("guided, adaptive grain", Schedule::Guided, 0);
+  measure("guided, grain 1", Schedule::Guided, 1);
+
+  {
+    // done runs once, after every index, for small and empty shapes too
+    int doneCount = 0;
+    bool correct = true;
+    for(Schedule schedule : {Schedule::Static, Schedule::Dynamic, Schedule::Guided}) {
+      for(int shape : {0, 1, 3, 1000}) {
+        auto counting = bulk_then_value(
+            [](const InputT& /*input*/, ShapeElementT /*idx*/, int& shared){ ++shared; },
+            [](const InputT& input){return input;},
+            privatized(
+              [](const int& /*shape*/, const InputT& /*input value*/){return 0;},
+              [](int lhs, int rhs){return lhs + rhs;}),
+            [&doneCount](int&& shared, auto& outputPromise) {
+              ++doneCount;
+              outputPromise.set_value(shared);
+            });
+        correct = correct && std::move(DriverExecutor<StealingDriver>{StealingDriver{pool, schedule, 0}}.then_execute(
+            counting, TrivialFuture<int>{shape})).get() == shape;
+      }
+    }
+    std::cout << "Results correct: " << correct << ", done calls: " << doneCount << "\n";
+  }
+
+  {
+    // A worker of this pool is an outside thread to a smaller one, so a bulk run it
+    // starts there spreads over the smaller pool's own deques and slots
+    WorkStealingPool smaller{1};
+    std::promise<std::pair<int, int>> nested;
+    pool.execute([&](){
+      auto counting = bulk_then_value(
+          [](const InputT& /*input*/, ShapeElementT /*idx*/, int& shared){ ++shared; },
+          [](const InputT& input){return input;},
+          privatized(
+            [](const int& /*shape*/, const InputT& /*input value*/){return 0;},
+            [](int lhs, int rhs){return lhs + rhs;}),
+          [](int&& shared, auto& outputPromise) {
+            outputPromise.set_value(shared);
+          });
+      const int counted = std::move(DriverExecutor<StealingDriver>{StealingDriver{smaller, Schedule::Dynamic, 1}}.then_execute(
+          counting, TrivialFuture<int>{1000})).get();
+      nested.set_value({smaller.worker_index(), counted});
+    });
+    auto [index, counted] = nested.get_future().get();
+    std::cout << "Run from another pool's worker: seen as outside " << (index == -1) << ", result " << counted << "\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include <chrono>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "bulk_model.h"
+
+// Two small vectors whose dot product is the result
+struct Vectors {
+  const float* a_;
+  const float* b_;
+  int size_;
+};
+
+constexpr int runs = 200000;
+
+// The same dot product with the size from the input and as a static shape
+template<int N, class Executor>
+void measure(Executor& executor, const char* name) {
+  std::vector<float> a(N);
+  std::vector<float> b(N);
+  for(int i = 0; i < N; ++i) {
+    a[i] = float(i % 7) * 0.5f;
+    b[i] = float(i % 5) * 0.25f;
+  }
+  const Vectors input{a.data(), b.data(), N};
+
+  auto dot = [](auto shape){
+    return bulk_then_value(
+      [](const Vectors& in, int i, float& shared){
+        shared += in.a_[i] * in.b_[i];
+      },
+      shape,
+      privatized([](const int& /*shape*/, const Vectors& /*input*/){return 0.0f;},
+                 [](float lhs, float rhs){return lhs + rhs;}),
+      [](float&& shared, auto& outputPromise) {
+        outputPromise.set_value(shared);
+      });
+  };
+  auto runtime = executor.template compile<Vectors, float>(dot([](const Vectors& in){return in.size_;}));
+  auto fixed = executor.template compile<Vectors, float>(dot([](const Vectors&){return static_shape<N>{};}));
+
+  auto nsPerRun = [&input](auto& plan, float& result){
+    result = std::move(plan.execute(TrivialFuture<Vectors>{input})).get();
+    return time_per_run<std::chrono::duration<double, std::nano>>([&](){
+      result += std::move(plan.execute(TrivialFuture<Vectors>{input})).get();
+    }, runs);
+  };
+  float runtimeResult = 0.0f;
+  float fixedResult = 0.0f;
+  const double runtimeNs = nsPerRun(runtime, runtimeResult);
+  const double fixedNs = nsPerRun(fixed, fixedResult);
+  std::cout << "  " << name << " N=" << N << ": runtime shape " << runtimeNs << "ns, static shape "
+            << fixedNs << "ns, " << runtimeNs / fixedNs << "x, results agree "
+            << (runtimeResult == fixedResult) << "\n";
+}
+
+template<class Executor, int... Ns>
+void measureAll(Executor& executor, const char* name, std::integer_sequence<int, Ns...>) {
+  (measure<Ns>(executor, name), ...);
+}
+
+int main() {
+  ThreadPool pool{default_pool_size(1)};
+  DriverExecutor<EndDriver> serial{};
+  DriverExecutor<ParallelDriver> parallel{ParallelDriver{pool}};
+  using Sizes = std::integer_sequence<int, 4, 8, 16, 32, 64>;
+
+  // Each shape is compared under the same driver. Only EndDriver runs a static shape
+  // as one block, so only there is the loop unrolled. ParallelDriver still splits it
+  // across the pool and runs the ordinary loop, so there both shapes should match.
+  std::cout << "Dot products of small vectors, per run of a compiled plan:\n";
+  measureAll(serial, "serial", Sizes{});
+  measureAll(parallel, "parallel", Sizes{});
+
+  {
+    // A body that stops still skips the rest of an unrolled shape
+    int ran = 0;
+    auto firstNegative = bulk_then_value(
+        [&ran](const Vectors& in, int i, int& shared){
+          ++ran;
+          if(in.a_[i] < 0.0f) {
+            shared = i;
+            return bulk_control::stop;
+          }
+          return bulk_control::proceed;
+        },
+        [](const Vectors&){return static_shape<32>{};},
+        [](const int& /*shape*/, const Vectors& /*input*/){return -1;},
+        [](int&& shared, auto& outputPromise) {
+          outputPromise.set_value(shared);
+        });
+    std::vector<float> a(32, 1.0f);
+    a[5] = -1.0f;
+    const int found = std::move(serial.then_execute<int>(firstNegative, TrivialFuture<Vectors>{Vectors{a.data(), a.data(), 32}})).get();
+    std::cout << "Stopping body: found " << found << " after " << ran << " of 32 indices\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "bulk_model.h"
+
+// Input passed by view so that each run measures the sweep and not a copy
+struct View {
+  const int* data_;
+  int size_;
+};
+using SharedStateT = atomic_move_wrapper<int>;
+
+int main() {
+  constexpr int size = 1 << 24;
+  constexpr int target = 1000;
+  constexpr int repetitions = 10;
+  ThreadPool pool{default_pool_size(1)};
+
+  std::vector<int> values(size);
+  for(int i = 0; i < size; ++i) {
+    values[i] = i;
+  }
+  const View input{values.data(), size};
+
+  auto shape = [](const View& in){return in.size_;};
+  auto notFound = [](const int& /*shape*/, const View& /*input value*/) -> SharedStateT {return {-1};};
+  auto found = [](SharedStateT&& shared, auto& outputPromise) {
+    outputPromise.set_value((*shared).load());
+  };
+
+  // Index of some element equal to target, looking at every element
+  auto findAll = bulk_then_value(
+      [](const View& in, int i, SharedStateT& shared){
+        if(in.data_[i] == target) {
+          (*shared).store(i);
+        }
+      },
+      shape, notFound, found);
+
+  // The same search, stopping the remaining indices once it finds one
+  auto findAny = bulk_then_value(
+      [](const View& in, int i, SharedStateT& shared){
+        if(in.data_[i] == target) {
+          (*shared).store(i);
+          return bulk_control::stop;
+        }
+        return bulk_control::proceed;
+      },
+      shape, notFound, found);
+
+  auto msPerRun = [&](auto executor, auto& continuation, int& result){
+    return time_per_run([&](){
+      result = std::move(executor.template then_execute<int>(continuation, TrivialFuture<View>{input})).get();
+    }, repetitions);
+  };
+  std::cout << "Search for " << target << " among " << size << " ints:\n";
+  int all = 0;
+  int any = 0;
+  auto serialAll = msPerRun(DriverExecutor<EndDriver>{}, findAll, all);
+  auto serialAny = msPerRun(DriverExecutor<EndDriver>{}, findAny, any);
+  std::cout << "  serial: every index " << serialAll << "ms, stopping " << serialAny
+            << "ms, found " << all << " and " << any << "\n";
+  auto parallelAll = msPerRun(DriverExecutor<ParallelDriver>{ParallelDriver{pool}}, findAll, all);
+  auto parallelAny = msPerRun(DriverExecutor<ParallelDriver>{ParallelDriver{pool}}, findAny, any);
+  std::cout << "  parallel: every index " << parallelAll << "ms, stopping " << parallelAny
+            << "ms, found " << all << " and " << any << "\n";
+
+  {
+    // A body that throws stops the rest too and its exception reaches the caller
+    std::atomic<int> ran{0};
+    auto throwing = bulk_then_value(
+        [&ran](const View& /*in*/, int i, SharedStateT& /*shared*/){
+          ++ran;
+          if(i == 10) {
+            throw std::runtime_error("bad element");
+          }
+        },
+        shape, notFound, found);
+    bool thrown = false;
+    try {
+      DriverExecutor<EndDriver>{}.then_execute<int>(throwing, TrivialFuture<View>{input});
+    } catch(const std::runtime_error&) {
+      thrown = true;
+    }
+    std::cout << "Throwing body: exception delivered " << thrown << ", indices run " << ran << " of " << size << "\n";
+  }
+
+  {
+    // A shape near INT_MAX is cut into blocks without overflow, and each block stops
+    // after its first index
+    std::atomic<int> ran{0};
+    auto huge = bulk_then_value(
+        [&ran](const View& /*in*/, int /*i*/, SharedStateT& /*shared*/){
+          ++ran;
+          return bulk_control::stop;
+        },
+        [](const View& /*in*/){return std::numeric_limits<int>::max();},
+        notFound, found);
+    DriverExecutor<ParallelDriver>{ParallelDriver{pool}}.then_execute<int>(huge, TrivialFuture<View>{input});
+    const int parallelRan = ran.exchange(0);
+    WorkStealingPool stealingPool{2};
+    DriverExecutor<StealingDriver>{StealingDriver{stealingPool, Schedule::Static, 0}}.then_execute<int>(
+        huge, TrivialFuture<View>{input});
+    std::cout << "INT_MAX indices: at most one index run per block, parallel "
+              << (parallelRan >= 1 && parallelRan <= static_cast<int>(pool.size()) + 1)
+              << ", stealing " << (ran >= 1 && ran <= 2) << "\n";
+  }
+
+  return 0;
+}
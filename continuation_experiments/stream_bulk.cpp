@@ -0,0 +1,157 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "bulk_model.h"
+
+using Chunk = std::vector<float>;
+
+constexpr int chunks = 16;
+constexpr int chunkSize = 1 << 16;
+// Time for each chunk to arrive, as if it came over the network
+constexpr auto arrival = std::chrono::milliseconds(10);
+
+Chunk make_chunk(int index) {
+  Chunk chunk(chunkSize);
+  for(int i = 0; i < chunkSize; ++i) {
+    chunk[i] = float((index * chunkSize + i) % 1000) / 1000.0f;
+  }
+  return chunk;
+}
+
+// Wait for the next chunk to arrive and return it
+Chunk receive(int index) {
+  std::this_thread::sleep_for(arrival);
+  return make_chunk(index);
+}
+
+// Costly per element, so that each chunk takes about as long to process as to arrive
+double score(float x) {
+  double y = x;
+  for(int i = 0; i < 8; ++i) {
+    y = std::sin(y) + x;
+  }
+  return y;
+}
+
+// Push the first count chunks to a stream from executor and return its result
+template<class Executor, class Continuation>
+double streamChunks(Executor executor, const Continuation& cont, int count) {
+  auto stream = executor.template stream<Chunk, double>(cont);
+  for(int c = 0; c < count; ++c) {
+    stream.push(make_chunk(c));
+  }
+  return std::move(stream.finish()).get();
+}
+
+int main() {
+  WorkStealingPool pool{default_pool_size()};
+  DriverExecutor<StealingDriver> executor{StealingDriver{pool, Schedule::Dynamic, 0}};
+
+  auto body = range_body([](const Chunk& chunk, int begin, int end, double& shared){
+    for(int i = begin; i < end; ++i) {
+      shared += score(chunk[i]);
+    }
+  });
+  auto shape = [](const Chunk& chunk){return static_cast<int>(chunk.size());};
+  auto sum = privatized([](const int&, const Chunk&){return 0.0;}, [](double lhs, double rhs){return lhs + rhs;});
+  auto selector = [](double&& shared, auto& outputPromise){ outputPromise.set_value(shared); };
+  auto cont = bulk_then_value(body, shape, sum, selector);
+
+  // Receive every chunk, then run the continuation once over all of them
+  double whole = 0;
+  const double wholeMs = time_per_run([&](){
+    Chunk received;
+    for(int c = 0; c < chunks; ++c) {
+      auto chunk = receive(c);
+      received.insert(received.end(), chunk.begin(), chunk.end());
+    }
+    whole = std::move(executor.then_execute<double>(cont, TrivialFuture<Chunk>{std::move(received)})).get();
+  });
+
+  // Run the same continuation on each chunk as soon as the chunk arrives
+  double streamed = 0;
+  const double streamMs = time_per_run([&](){
+    auto stream = executor.stream<Chunk, double>(cont);
+    for(int c = 0; c < chunks; ++c) {
+      stream.push(receive(c));
+    }
+    streamed = std::move(stream.finish()).get();
+  });
+
+  std::cout << chunks << " chunks of " << chunkSize << " floats, each arriving after "
+            << arrival.count() << "ms, " << pool.size() << " workers:\n"
+            << "  receive all, then compute: " << wholeMs << "ms\n"
+            << "  compute each chunk on arrival: " << streamMs << "ms\n"
+            << "  same result: " << (std::abs(whole - streamed) < 1e-6 * std::abs(whole)) << "\n";
+
+  {
+    // A stream is a mode of any driver, so the continuation streams serially too
+    ThreadPool threads{default_pool_size(1)};
+    const double stealing = streamChunks(executor, cont, 4);
+    const double serial = streamChunks(DriverExecutor<EndDriver>{}, cont, 4);
+    const double parallel = streamChunks(DriverExecutor<ParallelDriver>{ParallelDriver{threads}}, cont, 4);
+    std::cout << "Same stream under EndDriver, ParallelDriver and StealingDriver: "
+              << (std::abs(serial - stealing) < 1e-6 * std::abs(serial) &&
+                  std::abs(serial - parallel) < 1e-6 * std::abs(serial)) << "\n";
+  }
+
+  {
+    // An exception from any chunk reaches finish
+    auto failing = executor.stream<Chunk, double>(bulk_then_value(
+        [](const Chunk& chunk, int i, double& /*shared*/){
+          if(chunk[i] < 0.0f) {
+            throw std::runtime_error("negative element");
+          }
+        },
+        shape, sum, selector));
+    failing.push(Chunk(8, 1.0f));
+    failing.push(Chunk(8, -1.0f));
+    failing.push(Chunk(8, 1.0f));
+    bool thrown = false;
+    try {
+      failing.finish();
+    } catch(const std::runtime_error&) {
+      thrown = true;
+    }
+    std::cout << "Exception from a chunk delivered: " << thrown << "\n";
+
+    // The states are gone once finish has run, so the stream takes no more chunks
+    bool rejected = false;
+    try {
+      failing.push(Chunk(8, 1.0f));
+    } catch(const std::logic_error&) {
+      rejected = true;
+    }
+    std::cout << "Push after finish rejected: " << rejected << "\n";
+  }
+
+  {
+    // A chunk starts while the one before it still runs, up to one per lane. Each
+    // chunk here is one serial block that takes a while.
+    std::atomic<int> running{0};
+    std::atomic<int> most{0};
+    auto slow = bulk_then_value(
+        range_body([&](const Chunk& /*chunk*/, int /*begin*/, int /*end*/, double& /*shared*/){
+          const int now = ++running;
+          int seen = most.load();
+          while(now > seen && !most.compare_exchange_weak(seen, now)) {
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(5));
+          --running;
+        }),
+        shape, sum, selector);
+    auto stream = DriverExecutor<EndDriver>{}.stream<Chunk, double>(slow, 3);
+    for(int c = 0; c < 6; ++c) {
+      stream.push(Chunk(8, 1.0f));
+    }
+    stream.finish();
+    std::cout << "Chunks in flight at once with 3 lanes: " << most << "\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "bulk_model.h"
+
+using InputT = int;
+using ShapeElementT = int;
+using SharedStateT = int;
+
+constexpr int n = 2048;
+
+// Transpose a square matrix, reading rows and writing columns. Flattened indices
+// stride through the output a whole row apart, tiles keep both sides in cache.
+template<class ShapeFactory, class Body>
+auto transpose(ShapeFactory shapeFactory, Body body) {
+  return bulk_then_value(
+      std::move(body),
+      std::move(shapeFactory),
+      [](const auto& /*shape*/, const InputT& /*input value*/) -> SharedStateT {return 0;},
+      [](SharedStateT&& shared, auto& outputPromise) {
+        outputPromise.set_value(shared);
+      });
+}
+
+int main() {
+  constexpr int repetitions = 10;
+  ThreadPool pool{default_pool_size(1)};
+  auto msPerRun = [&](auto executor, auto& continuation){
+    return time_per_run([&](){
+      std::move(executor.then_execute(continuation, TrivialFuture<int>{0})).get();
+    }, repetitions);
+  };
+
+  std::vector<float> in(n * n);
+  std::vector<float> out(n * n);
+  for(int i = 0; i < n * n; ++i) {
+    in[i] = float(i);
+  }
+  const float* src = in.data();
+  float* dst = out.data();
+
+  auto flat = transpose(
+      [](const InputT& /*input value*/){return n * n;},
+      range_body([src, dst](const InputT& /*input*/, ShapeElementT begin, ShapeElementT end, SharedStateT& /*shared*/){
+        for(ShapeElementT idx = begin; idx < end; ++idx) {
+          dst[(idx % n) * n + idx / n] = src[idx];
+        }
+      }));
+  auto tileBody = [src, dst](const InputT& /*input*/, const Tile<2>& tile, SharedStateT& /*shared*/){
+    for(int i = tile.begin_[0]; i < tile.end_[0]; ++i) {
+      for(int j = tile.begin_[1]; j < tile.end_[1]; ++j) {
+        dst[j * n + i] = src[i * n + j];
+      }
+    }
+  };
+  auto rowMajor = transpose(
+      [](const InputT& /*input value*/){return TiledShape<2>{{n, n}, {64, 64}, TileOrder::RowMajor};},
+      tileBody);
+  auto morton = transpose(
+      [](const InputT& /*input value*/){return TiledShape<2>{{n, n}, {64, 64}, TileOrder::Morton};},
+      tileBody);
+
+  auto checkTranspose = [&]() {
+    bool correct = true;
+    for(int i = 0; i < n; ++i) {
+      for(int j = 0; j < n; ++j) {
+        correct = correct && out[j * n + i] == in[i * n + j];
+      }
+    }
+    std::fill(out.begin(), out.end(), 0.0f);
+    return correct;
+  };
+
+  using Serial = DriverExecutor<EndDriver>;
+  using Parallel = DriverExecutor<ParallelDriver>;
+  std::cout << "Transpose of " << n << "x" << n << " floats, 64x64 tiles, " << pool.size() + 1 << " threads:\n";
+  std::cout << "  flattened indices: serial " << msPerRun(Serial{}, flat) << "ms, parallel "
+            << msPerRun(Parallel{ParallelDriver{pool}}, flat) << "ms, correct " << checkTranspose() << "\n";
+  std::cout << "  row-major tiles: serial " << msPerRun(Serial{}, rowMajor) << "ms, parallel "
+            << msPerRun(Parallel{ParallelDriver{pool}}, rowMajor) << "ms, correct " << checkTranspose() << "\n";
+  std::cout << "  Morton tiles: serial " << msPerRun(Serial{}, morton) << "ms, parallel "
+            << msPerRun(Parallel{ParallelDriver{pool}}, morton) << "ms, correct " << checkTranspose() << "\n";
+
+  {
+    // Every index of a ragged 3D shape is visited exactly once, in either order
+    constexpr int x = 37, y = 21, z = 50;
+    std::vector<int> visits(x * y * z);
+    int* counts = visits.data();
+    auto visit = [counts](const InputT& /*input*/, const Tile<3>& tile, int& shared){
+      for_each_index(tile, [&](const std::array<int, 3>& idx){
+        ++counts[(idx[0] * y + idx[1]) * z + idx[2]];
+        ++shared;
+      });
+    };
+    bool exact = true;
+    for(TileOrder order : {TileOrder::RowMajor, TileOrder::Morton}) {
+      std::fill(visits.begin(), visits.end(), 0);
+      auto body = visit;
+      auto cover = bulk_then_value(
+          std::move(body),
+          [order](const InputT& /*input value*/){return TiledShape<3>{{x, y, z}, {8, 4, 16}, order};},
+          privatized(
+            [](const TiledShape<3>& /*shape*/, const InputT& /*input value*/) {return int{0};},
+            [](int lhs, int rhs) {return lhs + rhs;}),
+          [](int&& shared, auto& outputPromise) {
+            outputPromise.set_value(shared);
+          });
+      int visited = std::move(Parallel{ParallelDriver{pool}}.then_execute(cover, TrivialFuture<int>{0})).get();
+      exact = exact && visited == x * y * z;
+      for(int count : visits) {
+        exact = exact && count == 1;
+      }
+    }
+    std::cout << "3D " << x << "x" << y << "x" << z << " shape visited exactly once: " << exact << "\n";
+  }
+
+  {
+    // A grid far too skewed for Morton codes to pay falls back to row-major, as does
+    // a shape in a single tile, and a tile size that is not positive is rejected
+    TiledShape<2> skewed{{1 << 30, 64}, {1 << 10, 64}, TileOrder::Morton};
+    TiledShape<2> single{{10, 10}, {64, 64}, TileOrder::Morton};
+    bool rejected = false;
+    try {
+      TiledShape<2> empty{{n, n}, {0, 64}};
+    } catch(const std::logic_error&) {
+      rejected = true;
+    }
+    std::cout << "Skewed Morton grid has all " << skewed.size() << " tiles, last at row "
+              << skewed.tile(skewed.size() - 1).begin_[0] << ", single-tile Morton grid has "
+              << single.size() << " tile, zero tile size rejected: " << rejected << "\n";
+  }
+
+  return 0;
+}